@@ -0,0 +1,4 @@
+#include "2015.h"
+
+
+bool force_scalar = false;
@@ -1,33 +1,57 @@
 #ifndef AOC_2015_H
 #define AOC_2015_H
 
-
-void
-day01(const char *input);
-
-
-void
-day02(const char *input);
-
-
-void
-day03(const char *input);
-
-
-void
-day04(void);
-
-
-void
-day05(const char *input);
-
-
-void
-day06(const char *input);
-
-
-void
-day07(const char *input);
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// SIMD kernels are written with x86 intrinsics and selected at runtime; other
+// targets only get the scalar code paths.
+#if defined(__x86_64__) || defined(__i386__)
+#define AOC_X86 1
+#else
+#define AOC_X86 0
+#endif
+
+
+// When set, solvers stick to their scalar code paths on a single thread, e.g.,
+// to produce reference answers for the SIMD kernels and threaded reductions to
+// be checked against.
+extern bool force_scalar;
+
+
+// Solves one part of a puzzle. The byte after the input is always 0.
+typedef int64_t Part(const char *input, size_t length);
+
+// Solves both parts of a puzzle at once, for puzzles where they share most of
+// their work.
+typedef void Solve(const char *input, size_t length, int64_t answers[2]);
+
+
+typedef struct Day
+{
+    const char *name;
+    // puzzle input, relative to the data directory; if 0, the puzzle input is
+    // the string in builtin_input
+    const char *filename;
+    const char *builtin_input;
+    Part *parts[2];
+    // optional
+    Solve *solve;
+    int64_t answers[2];
+    // printf formats for reporting each part's answer
+    const char *reports[2];
+} Day;
+
+
+extern const Day day01;
+extern const Day day02;
+extern const Day day03;
+extern const Day day04;
+extern const Day day05;
+extern const Day day06;
+extern const Day day07;
 
 
 #endif // AOC_2015_H
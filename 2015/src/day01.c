@@ -1,15 +1,55 @@
 #include "2015.h"
+#include "parallel.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#if AOC_X86
+#include <immintrin.h>
+#endif
 
-static int
-part1(const char *input)
+
+// The floor drops by at most one per instruction, so from floor f Santa can't
+// reach the basement within the next f instructions. Once he's at least this
+// high, the search skips ahead by just counting floors.
+#define SKIP_FLOOR 64
+
+
+// How the floor changes over a stretch of instructions, relative to the floor
+// at its start.
+typedef struct FloorSummary
+{
+    int64_t delta;
+    int64_t lowest;
+} FloorSummary;
+
+
+typedef int64_t CountFloors(const char *input, size_t length);
+
+// Returns the (1-based) position of the instruction that first takes Santa from
+// `floor` to the basement, or 0 if he never gets there.
+typedef size_t FindBasement(const char *input, size_t length, int64_t floor);
+
+typedef void SummarizeFloors(const char *input, size_t length, FloorSummary *summary);
+
+
+typedef struct FloorKernels
 {
-    int floor = 0;
-    for (char c = *input++; c; c = *input++)
+    CountFloors *count_floors;
+    FindBasement *find_basement;
+    SummarizeFloors *summarize_floors;
+} FloorKernels;
+
+
+static int64_t
+count_floors_scalar(const char *input, size_t length)
+{
+    int64_t floor = 0;
+    for (size_t i = 0; i < length; ++i)
     {
+        char c = input[i];
         floor += (c == '(') - (c == ')');
     }
 
@@ -17,31 +57,496 @@ part1(const char *input)
 }
 
 
-static int
-part2(const char *input)
+static size_t
+find_basement_scalar(const char *input, size_t length, int64_t floor)
 {
-    int floor = 0;
-    int pos = 0;
-    char c;
-    while ((floor != -1) && (c = input[pos++]))
+    for (size_t i = 0; i < length; ++i)
     {
+        char c = input[i];
         floor += (c == '(') - (c == ')');
+        if (floor == -1)
+        {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+// Extends a summary with more instructions from its stretch.
+static void
+extend_summary(FloorSummary *summary, const char *input, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        char c = input[i];
+        summary->delta += (c == '(') - (c == ')');
+        if (summary->delta < summary->lowest)
+        {
+            summary->lowest = summary->delta;
+        }
+    }
+}
+
+
+static void
+summarize_floors_scalar(const char *input, size_t length, FloorSummary *summary)
+{
+    FloorSummary result = {0};
+    extend_summary(&result, input, length);
+    *summary = result;
+}
+
+
+#if AOC_X86
+
+// Counting: each 16 or 32 byte chunk is compared against both parentheses, and
+// the per-byte results are collapsed to bitmasks whose population counts give
+// the number of each in the chunk.
+//
+// Searching: outside of skipping ahead, the floor is tracked one block at a
+// time. Each instruction's step (+1, -1, or 0) becomes a signed byte, and a
+// log-step prefix sum over the block gives the floor after each instruction
+// relative to the floor before the block. Blocks are only examined this way
+// within SKIP_FLOOR of the floor being looked for, so one compare against a
+// broadcast byte finds the instructions that reach it.
+
+__attribute__((target("sse2")))
+static int64_t
+count_floors_sse2(const char *input, size_t length)
+{
+    const __m128i up = _mm_set1_epi8('(');
+    const __m128i down = _mm_set1_epi8(')');
+
+    int64_t floor = 0;
+    size_t i = 0;
+    for (; (i + 64) <= length; i += 64)
+    {
+        uint64_t ups = 0;
+        uint64_t downs = 0;
+        for (size_t j = 0; j < 64; j += 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)(input + i + j));
+            ups |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, up)) << j;
+            downs |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, down)) << j;
+        }
+
+        floor += __builtin_popcountll(ups) - __builtin_popcountll(downs);
+    }
+
+    floor += count_floors_scalar(input + i, length - i);
+    return floor;
+}
+
+
+__attribute__((target("sse2")))
+static __m128i
+prefix_floors_sse2(const char *input)
+{
+    __m128i chunk = _mm_loadu_si128((const __m128i *)input);
+    __m128i floors = _mm_sub_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(')')),
+                                  _mm_cmpeq_epi8(chunk, _mm_set1_epi8('(')));
+    floors = _mm_add_epi8(floors, _mm_slli_si128(floors, 1));
+    floors = _mm_add_epi8(floors, _mm_slli_si128(floors, 2));
+    floors = _mm_add_epi8(floors, _mm_slli_si128(floors, 4));
+    floors = _mm_add_epi8(floors, _mm_slli_si128(floors, 8));
+    return floors;
+}
+
+
+__attribute__((target("sse2")))
+static size_t
+find_basement_sse2(const char *input, size_t length, int64_t floor)
+{
+    assert(floor >= 0);
+
+    size_t i = 0;
+    while ((i + 16) <= length)
+    {
+        size_t remaining = length - i;
+        if ((uint64_t)floor >= remaining)
+        {
+            return 0;
+        }
+
+        if (floor >= SKIP_FLOOR)
+        {
+            size_t skip = (size_t)floor & ~(size_t)(SKIP_FLOOR - 1);
+            floor += count_floors_sse2(input + i, skip);
+            i += skip;
+            continue;
+        }
+
+        __m128i floors = prefix_floors_sse2(input + i);
+        __m128i basement = _mm_cmplt_epi8(floors, _mm_set1_epi8((char)-floor));
+        uint32_t below = (uint32_t)_mm_movemask_epi8(basement);
+        if (below)
+        {
+            return i + (size_t)__builtin_ctz(below) + 1;
+        }
+
+        floor += (int8_t)(_mm_extract_epi16(floors, 7) >> 8);
+        i += 16;
     }
 
-    return pos;
+    size_t result = find_basement_scalar(input + i, length - i, floor);
+    if (result)
+    {
+        result += i;
+    }
+
+    return result;
 }
 
 
-void
-day01(const char *input)
+__attribute__((target("sse2")))
+static void
+summarize_floors_sse2(const char *input, size_t length, FloorSummary *summary)
 {
-    puts("Day 01:");
+    FloorSummary result = {0};
+
+    size_t i = 0;
+    while ((i + 16) <= length)
+    {
+        int64_t headroom = result.delta - result.lowest;
+        size_t remaining = length - i;
+        if ((headroom >= SKIP_FLOOR) && (remaining >= SKIP_FLOOR))
+        {
+            size_t skip = (size_t)headroom & ~(size_t)(SKIP_FLOOR - 1);
+            if (skip > remaining)
+            {
+                skip = remaining & ~(size_t)(SKIP_FLOOR - 1);
+            }
+
+            result.delta += count_floors_sse2(input + i, skip);
+            i += skip;
+            continue;
+        }
+
+        // A block can't drop more than 16 floors, so a larger headroom is
+        // equivalent and keeps the threshold in a byte.
+        if (headroom > 16)
+        {
+            headroom = 16;
+        }
 
-    int result = part1(input);
-    assert(result == 74);
-    printf("The instructions take Santa to floor %d.\n", result);
+        __m128i floors = prefix_floors_sse2(input + i);
+        __m128i lower = _mm_cmplt_epi8(floors, _mm_set1_epi8((char)-headroom));
+        if (_mm_movemask_epi8(lower))
+        {
+            // New low; rescan this block to find how low.
+            extend_summary(&result, input + i, 16);
+        }
+        else
+        {
+            result.delta += (int8_t)(_mm_extract_epi16(floors, 7) >> 8);
+        }
+
+        i += 16;
+    }
 
-    result = part2(input);
-    assert(result == 1795);
-    printf("Santa reaches the basement at instruction %d.\n", result);
+    extend_summary(&result, input + i, length - i);
+    *summary = result;
 }
+
+
+__attribute__((target("avx2,popcnt")))
+static int64_t
+count_floors_avx2(const char *input, size_t length)
+{
+    const __m256i up = _mm256_set1_epi8('(');
+    const __m256i down = _mm256_set1_epi8(')');
+
+    int64_t floor = 0;
+    size_t i = 0;
+    for (; (i + 64) <= length; i += 64)
+    {
+        __m256i low = _mm256_loadu_si256((const __m256i *)(input + i));
+        __m256i high = _mm256_loadu_si256((const __m256i *)(input + i + 32));
+
+        uint64_t ups = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, up))
+            | ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, up)) << 32);
+        uint64_t downs = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, down))
+            | ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, down)) << 32);
+
+        floor += __builtin_popcountll(ups) - __builtin_popcountll(downs);
+    }
+
+    floor += count_floors_scalar(input + i, length - i);
+    return floor;
+}
+
+
+__attribute__((target("avx2,popcnt")))
+static __m256i
+prefix_floors_avx2(const char *input)
+{
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)input);
+    __m256i floors = _mm256_sub_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(')')),
+                                     _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('(')));
+    floors = _mm256_add_epi8(floors, _mm256_slli_si256(floors, 1));
+    floors = _mm256_add_epi8(floors, _mm256_slli_si256(floors, 2));
+    floors = _mm256_add_epi8(floors, _mm256_slli_si256(floors, 4));
+    floors = _mm256_add_epi8(floors, _mm256_slli_si256(floors, 8));
+
+    // The byte shifts only work within each 16-byte half, so the low half's
+    // total is carried into the high half afterwards.
+    __m256i totals = _mm256_shuffle_epi8(floors, _mm256_set1_epi8(15));
+    floors = _mm256_add_epi8(floors, _mm256_permute2x128_si256(totals, totals, 0x08));
+    return floors;
+}
+
+
+__attribute__((target("avx2,popcnt")))
+static size_t
+find_basement_avx2(const char *input, size_t length, int64_t floor)
+{
+    assert(floor >= 0);
+
+    size_t i = 0;
+    while ((i + 32) <= length)
+    {
+        size_t remaining = length - i;
+        if ((uint64_t)floor >= remaining)
+        {
+            return 0;
+        }
+
+        if (floor >= SKIP_FLOOR)
+        {
+            size_t skip = (size_t)floor & ~(size_t)(SKIP_FLOOR - 1);
+            floor += count_floors_avx2(input + i, skip);
+            i += skip;
+            continue;
+        }
+
+        __m256i floors = prefix_floors_avx2(input + i);
+        __m256i basement = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)-floor), floors);
+        uint32_t below = (uint32_t)_mm256_movemask_epi8(basement);
+        if (below)
+        {
+            return i + (size_t)__builtin_ctz(below) + 1;
+        }
+
+        floor += (int8_t)_mm256_extract_epi8(floors, 31);
+        i += 32;
+    }
+
+    size_t result = find_basement_scalar(input + i, length - i, floor);
+    if (result)
+    {
+        result += i;
+    }
+
+    return result;
+}
+
+
+__attribute__((target("avx2,popcnt")))
+static void
+summarize_floors_avx2(const char *input, size_t length, FloorSummary *summary)
+{
+    FloorSummary result = {0};
+
+    size_t i = 0;
+    while ((i + 32) <= length)
+    {
+        int64_t headroom = result.delta - result.lowest;
+        size_t remaining = length - i;
+        if ((headroom >= SKIP_FLOOR) && (remaining >= SKIP_FLOOR))
+        {
+            size_t skip = (size_t)headroom & ~(size_t)(SKIP_FLOOR - 1);
+            if (skip > remaining)
+            {
+                skip = remaining & ~(size_t)(SKIP_FLOOR - 1);
+            }
+
+            result.delta += count_floors_avx2(input + i, skip);
+            i += skip;
+            continue;
+        }
+
+        // A block can't drop more than 32 floors, so a larger headroom is
+        // equivalent and keeps the threshold in a byte.
+        if (headroom > 32)
+        {
+            headroom = 32;
+        }
+
+        __m256i floors = prefix_floors_avx2(input + i);
+        __m256i lower = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)-headroom), floors);
+        if (_mm256_movemask_epi8(lower))
+        {
+            // New low; rescan this block to find how low.
+            extend_summary(&result, input + i, 32);
+        }
+        else
+        {
+            result.delta += (int8_t)_mm256_extract_epi8(floors, 31);
+        }
+
+        i += 32;
+    }
+
+    extend_summary(&result, input + i, length - i);
+    *summary = result;
+}
+
+#endif // AOC_X86
+
+
+static FloorKernels
+select_floor_kernels(void)
+{
+    FloorKernels result = {
+        .count_floors = count_floors_scalar,
+        .find_basement = find_basement_scalar,
+        .summarize_floors = summarize_floors_scalar,
+    };
+
+#if AOC_X86
+    __builtin_cpu_init();
+    if (force_scalar)
+    {
+        // keep the scalar kernels
+    }
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    {
+        result.count_floors = count_floors_avx2;
+        result.find_basement = find_basement_avx2;
+        result.summarize_floors = summarize_floors_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        result.count_floors = count_floors_sse2;
+        result.find_basement = find_basement_sse2;
+        result.summarize_floors = summarize_floors_sse2;
+    }
+#endif
+
+    return result;
+}
+
+
+//
+// Parallel reduction
+//
+// Large inputs are split into one chunk per worker. Each worker summarizes its
+// chunk independently, and the summaries are then combined in order: the floor
+// entering a chunk is the sum of the deltas before it, so the chunk where
+// Santa enters the basement is the first whose lowest floor, offset by that,
+// reaches -1. Only that chunk is searched again.
+//
+
+typedef struct FloorChunks
+{
+    const char *input;
+    size_t length;
+    size_t chunk_size;
+    uint32_t nchunks;
+    FloorKernels kernels;
+    FloorSummary summaries[MAX_WORKERS];
+} FloorChunks;
+
+
+static void
+split_floor_chunks(FloorChunks *chunks, const char *input, size_t length)
+{
+    chunks->input = input;
+    chunks->length = length;
+    chunks->kernels = select_floor_kernels();
+
+    uint32_t nchunks = input_chunk_count(length);
+    chunks->chunk_size = (length + nchunks - 1) / nchunks;
+    chunks->nchunks = nchunks;
+}
+
+
+static void
+count_chunk(void *data, uint32_t worker)
+{
+    FloorChunks *chunks = data;
+    const char *input = chunks->input + (worker * chunks->chunk_size);
+    size_t length = chunk_length(chunks->length, chunks->chunk_size, worker);
+
+    FloorSummary *summary = chunks->summaries + worker;
+    summary->delta = chunks->kernels.count_floors(input, length);
+}
+
+
+static void
+summarize_chunk(void *data, uint32_t worker)
+{
+    FloorChunks *chunks = data;
+    const char *input = chunks->input + (worker * chunks->chunk_size);
+    size_t length = chunk_length(chunks->length, chunks->chunk_size, worker);
+
+    chunks->kernels.summarize_floors(input, length, chunks->summaries + worker);
+}
+
+
+static int64_t
+part1(const char *input, size_t length)
+{
+    FloorChunks chunks;
+    split_floor_chunks(&chunks, input, length);
+    run_parallel(count_chunk, &chunks, chunks.nchunks);
+
+    int64_t result = 0;
+    for (uint32_t i = 0; i < chunks.nchunks; ++i)
+    {
+        result += chunks.summaries[i].delta;
+    }
+
+    return result;
+}
+
+
+static int64_t
+part2(const char *input, size_t length)
+{
+    FloorChunks chunks;
+    split_floor_chunks(&chunks, input, length);
+
+    size_t result = 0;
+    if (chunks.nchunks == 1)
+    {
+        result = chunks.kernels.find_basement(input, length, 0);
+    }
+    else
+    {
+        run_parallel(summarize_chunk, &chunks, chunks.nchunks);
+
+        int64_t floor = 0;
+        for (uint32_t i = 0; i < chunks.nchunks; ++i)
+        {
+            FloorSummary *summary = chunks.summaries + i;
+            if ((floor + summary->lowest) <= -1)
+            {
+                size_t offset = i * chunks.chunk_size;
+                size_t chunk = chunk_length(length, chunks.chunk_size, i);
+                result = chunks.kernels.find_basement(input + offset, chunk, floor);
+                assert(result);
+                result += offset;
+                break;
+            }
+
+            floor += summary->delta;
+        }
+    }
+
+    return (int64_t)result;
+}
+
+
+const Day day01 = {
+    .name = "Day 01",
+    .filename = "day01.txt",
+    .parts = { part1, part2 },
+    .answers = { 74, 1795 },
+    .reports = {
+        "The instructions take Santa to floor %" PRId64 ".",
+        "Santa reaches the basement at instruction %" PRId64 ".",
+    },
+};
@@ -1,34 +1,16 @@
 #include "2015.h"
+#include "parallel.h"
 
 #include <assert.h>
-#include <ctype.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <stdlib.h> // strtol
+#include <string.h>
 
-
-static void
-swap_ints(int *a, int *b)
-{
-    *a ^= *b;
-    *b ^= *a;
-    *a ^= *b;
-}
-
-
-static void
-sort_ints(int *dims)
-{
-    if (dims[0] > dims[1])
-    {
-        swap_ints(dims + 0, dims + 1);
-    }
-    if (dims[1] > dims[2])
-    {
-        swap_ints(dims + 1, dims + 2);
-    }
-}
+#if AOC_X86
+#include <immintrin.h>
+#endif
 
 
 static bool
@@ -56,10 +38,14 @@ parse_int(const char *input, const char **next)
 }
 
 
+// Sides are capped so a box's volume, and so its ribbon, fits 64 bits.
+#define MAX_SIDE 1000000
+
+
 static const char *
 parse_dimension(const char *input, int *dims)
 {
-    assert (isdigit(*input));
+    assert(is_digit(*input));
 
     const char *next;
     dims[0] = parse_int(input, &next);
@@ -71,90 +57,604 @@ parse_dimension(const char *input, int *dims)
     input = ++next;
 
     dims[2] = parse_int(input, &next);
-    assert(!isdigit(*next));
-    input = next;
+    assert(!is_digit(*next));
+
+    assert((dims[0] <= MAX_SIDE) && (dims[1] <= MAX_SIDE) && (dims[2] <= MAX_SIDE));
+
+    return next;
+}
+
+
+//
+// Parsing
+//
+// Boxes are parsed in batches, a column per side, small enough to stay in L1.
+// A parser adds as many boxes as it can to a batch, and is left positioned at
+// the start of the next box.
+//
+
+#define BOX_BATCH 1024
+
+
+typedef struct Boxes
+{
+    size_t count;
+    int l[BOX_BATCH];
+    int w[BOX_BATCH];
+    int h[BOX_BATCH];
+} Boxes;
+
+
+static void
+add_box(Boxes *boxes, const int *dims)
+{
+    assert(boxes->count < BOX_BATCH);
+    boxes->l[boxes->count] = dims[0];
+    boxes->w[boxes->count] = dims[1];
+    boxes->h[boxes->count] = dims[2];
+    ++boxes->count;
+}
+
+
+typedef struct BoxParser BoxParser;
+
+// Returns the number of boxes added, or 0 at the end of the input.
+typedef size_t ParseBoxes(BoxParser *parser, Boxes *boxes);
+
+struct BoxParser
+{
+    const char *start;
+    const char *input;
+    const char *end;
+    ParseBoxes *parse;
+};
 
-    sort_ints(dims);
 
-    while (*input && !isdigit(*input))
+// Moves past anything between boxes.
+static void
+skip_to_box(BoxParser *parser)
+{
+    while ((parser->input < parser->end) && !is_digit(*parser->input))
     {
-        ++input;
+        ++parser->input;
     }
+}
 
-    return input;
+
+static const char *
+parse_box(const char *input, Boxes *boxes)
+{
+    int dims[3];
+    const char *result = parse_dimension(input, dims);
+    add_box(boxes, dims);
+    return result;
 }
 
 
-static int
-part1(const char *input)
+static size_t
+parse_boxes_scalar(BoxParser *parser, Boxes *boxes)
 {
-    int result = 0;
+    size_t result = 0;
+    while ((parser->input < parser->end) && (boxes->count < BOX_BATCH))
+    {
+        parser->input = parse_box(parser->input, boxes);
+        skip_to_box(parser);
+        ++result;
+    }
+
+    return result;
+}
+
+
+#if AOC_X86
+
+// Input is taken 64 bytes at a time, classified with a few compares into
+// digits, 'x's and newlines, and cut back to the last complete line in the
+// block. Digit values are combined with the two bytes before them (loaded again
+// at offsets of -1 and -2) so the lane holding a number's last digit holds the
+// whole number, i.e., 100*d[i-2] + 10*d[i-1] + d[i], where bytes belonging to
+// another number, or that aren't digits, contribute 0. The numbers are then
+// read out at the end of each digit run.
+//
+// Blocks start at the start of a line, and the line before it supplies the
+// bytes at -1 and -2, so the first line is left to the scalar parser. Anything
+// unexpected in a block (numbers longer than 3 digits, stray characters,
+// separators out of order) sends a line through the scalar parser instead.
+
+#define BOX_BLOCK 64
+// i.e., BOX_BLOCK / strlen("1x1x1\n"), rounded up
+#define MAX_BLOCK_BOXES 11
+
 
-    while (*input)
+typedef struct BoxBlock
+{
+    uint64_t digits;
+    uint64_t xs;
+    uint64_t newlines;
+    uint16_t values[BOX_BLOCK];
+} BoxBlock;
+
+
+__attribute__((target("sse2")))
+static __m128i
+digit_values_sse2(__m128i chunk, __m128i *is_digit)
+{
+    __m128i digits = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+    *is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+    __m128i result = _mm_and_si128(digits, *is_digit);
+    return result;
+}
+
+
+__attribute__((target("sse2")))
+static void
+classify_block_sse2(const char *input, BoxBlock *block)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i hundred = _mm_set1_epi16(100);
+
+    block->digits = 0;
+    block->xs = 0;
+    block->newlines = 0;
+
+    for (size_t i = 0; i < BOX_BLOCK; i += 16)
     {
-        int dims[3];
-        input = parse_dimension(input, dims);
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i is_digit;
+        __m128i ones = digit_values_sse2(chunk, &is_digit);
+
+        __m128i is_tens_digit;
+        __m128i tens = digit_values_sse2(_mm_loadu_si128((const __m128i *)(input + i - 1)), &is_tens_digit);
+
+        __m128i is_hundreds_digit;
+        __m128i hundreds = digit_values_sse2(_mm_loadu_si128((const __m128i *)(input + i - 2)), &is_hundreds_digit);
+        hundreds = _mm_and_si128(hundreds, is_tens_digit);
+
+        // x*10 as (x << 3) + (x << 1) stays within each byte for digits.
+        __m128i ones_tens = _mm_add_epi8(ones, _mm_add_epi8(_mm_slli_epi16(tens, 3), _mm_slli_epi16(tens, 1)));
+        _mm_storeu_si128((__m128i *)(block->values + i),
+                         _mm_add_epi16(_mm_unpacklo_epi8(ones_tens, zero),
+                                       _mm_mullo_epi16(_mm_unpacklo_epi8(hundreds, zero), hundred)));
+        _mm_storeu_si128((__m128i *)(block->values + i + 8),
+                         _mm_add_epi16(_mm_unpackhi_epi8(ones_tens, zero),
+                                       _mm_mullo_epi16(_mm_unpackhi_epi8(hundreds, zero), hundred)));
+
+        block->digits |= (uint64_t)(uint32_t)_mm_movemask_epi8(is_digit) << i;
+        block->xs |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('x'))) << i;
+        block->newlines |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))) << i;
+    }
+}
 
-        // wrapping paper
-        int small = dims[0] * dims[1];
-        int medium = dims[1] * dims[2];
-        int large = dims[2] * dims[0];
 
-        result += (3 * small) + (2 * medium) + (2 * large);
+// Returns the number of boxes read from a classified block, and how much of
+// the input they took up, or 0 if the block isn't in the expected format.
+static size_t
+read_block(const BoxBlock *block, Boxes *boxes, size_t *consumed)
+{
+    if (!block->newlines)
+    {
+        return 0;
     }
 
+    uint32_t line_end = 63 - (uint32_t)__builtin_clzll(block->newlines);
+    uint64_t keep = (line_end == 63) ? UINT64_MAX : ((uint64_t)2 << line_end) - 1;
+    uint64_t digits = block->digits & keep;
+    uint64_t newlines = block->newlines & keep;
+
+    // Every byte is a digit or separator, every separator follows a number, no
+    // number is longer than 3 digits, and there are 3 numbers for every line.
+    uint64_t separators = (block->xs | newlines) & keep;
+    uint64_t ends = digits & ~(digits >> 1);
+    bool well_formed = ((digits | separators) == keep)
+                    && ((ends << 1) == separators)
+                    && !(digits & (digits >> 1) & (digits >> 2) & (digits >> 3))
+                    && (__builtin_popcountll(ends) == 3 * __builtin_popcountll(newlines));
+    if (!well_formed)
+    {
+        return 0;
+    }
+
+    // Since every number is followed by a separator, a line is well formed if
+    // its third number is the one followed by its newline.
+    size_t result = 0;
+    size_t count = boxes->count;
+    uint64_t misplaced = 0;
+    for (; newlines; newlines &= newlines - 1, ++result)
+    {
+        uint32_t first = (uint32_t)__builtin_ctzll(ends);
+        ends &= ends - 1;
+        uint32_t second = (uint32_t)__builtin_ctzll(ends);
+        ends &= ends - 1;
+        uint32_t third = (uint32_t)__builtin_ctzll(ends);
+        ends &= ends - 1;
+
+        boxes->l[count + result] = block->values[first];
+        boxes->w[count + result] = block->values[second];
+        boxes->h[count + result] = block->values[third];
+
+        misplaced |= (third + 1) ^ (uint32_t)__builtin_ctzll(newlines);
+    }
+
+    if (misplaced)
+    {
+        result = 0;
+    }
+
+    boxes->count += result;
+    *consumed = line_end + 1;
     return result;
 }
 
 
-static int
-part2(const char *input)
+__attribute__((target("sse2")))
+static size_t
+parse_boxes_sse2(BoxParser *parser, Boxes *boxes)
 {
-    int result = 0;
+    size_t result = 0;
 
-    while (*input)
+    // the first line, for want of bytes before it
+    if (((parser->input - parser->start) < 2) && (parser->input < parser->end) && (boxes->count < BOX_BATCH))
     {
-        int dims[3];
-        input = parse_dimension(input, dims);
+        parser->input = parse_box(parser->input, boxes);
+        skip_to_box(parser);
+        ++result;
+    }
 
-        // ribbons
-        result += (2 * dims[0]) + (2 * dims[1]) + (dims[0] * dims[1] * dims[2]);
+    while (((size_t)(parser->end - parser->input) >= BOX_BLOCK) && ((boxes->count + MAX_BLOCK_BOXES) <= BOX_BATCH))
+    {
+        BoxBlock block;
+        classify_block_sse2(parser->input, &block);
+
+        size_t consumed;
+        size_t count = read_block(&block, boxes, &consumed);
+        if (count)
+        {
+            parser->input += consumed;
+            result += count;
+        }
+        else
+        {
+            parser->input = parse_box(parser->input, boxes);
+            ++result;
+        }
+
+        skip_to_box(parser);
+    }
+
+    // the last few bytes
+    if ((size_t)(parser->end - parser->input) < BOX_BLOCK)
+    {
+        result += parse_boxes_scalar(parser, boxes);
     }
 
     return result;
 }
 
+#endif // AOC_X86
+
+
+static void
+init_box_parser(BoxParser *parser, const char *input, size_t length)
+{
+    parser->start = input;
+    parser->input = input;
+    parser->end = input + length;
+    parser->parse = parse_boxes_scalar;
+
+#if AOC_X86
+    __builtin_cpu_init();
+    if (!force_scalar && __builtin_cpu_supports("sse2"))
+    {
+        parser->parse = parse_boxes_sse2;
+    }
+#endif
+
+    skip_to_box(parser);
+}
+
 
-void
-day02(const char *input)
+//
+// Measuring
+//
+// Both parts only need the two shortest sides of each box, i.e., the smaller
+// of the first two and the smaller of the larger one and the third, which is
+// two steps of a min/max sorting network.
+//
+
+typedef struct Order
 {
+    int64_t paper;
+    int64_t ribbon;
+} Order;
+
+
+// Adds a batch of boxes' paper and ribbon to an order.
+typedef void MeasureBoxes(const Boxes *boxes, Order *order);
+
+
+// Sides are widened before they're multiplied, as the areas of large boxes
+// overflow 32 bits.
+static void
+measure_box(int side_l, int side_w, int side_h, Order *order)
+{
+    int64_t l = side_l;
+    int64_t w = side_w;
+    int64_t h = side_h;
+    int64_t shortest = (l < w) ? l : w;
+    int64_t longer = (l < w) ? w : l;
+    int64_t second = (longer < h) ? longer : h;
+
+    // wrapping paper
+    int64_t lw = l * w;
+    order->paper += (2 * (lw + (w * h) + (h * l))) + (shortest * second);
+
+    // ribbons
+    order->ribbon += (2 * (shortest + second)) + (lw * h);
+}
+
+
+static void
+measure_boxes_scalar(const Boxes *boxes, Order *order)
+{
+    for (size_t i = 0; i < boxes->count; ++i)
+    {
+        measure_box(boxes->l[i], boxes->w[i], boxes->h[i], order);
+    }
+}
+
+
+#if AOC_X86
+
+// Eight boxes at a time, as two sets of four in 64-bit lanes: the sides in the
+// even 32-bit lanes, and then the odd ones shifted down into them. Sides are
+// never negative, so _mm256_mul_epu32 gives their full 64-bit products. A
+// volume is an area, which may take more than 32 bits, times a side, so it's
+// put together from the area's low and high halves.
+
+__attribute__((target("avx2")))
+static __m256i
+volume_avx2(__m256i area, __m256i side)
+{
+    __m256i low = _mm256_mul_epu32(area, side);
+    __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(area, 32), side);
+    __m256i result = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+    return result;
+}
+
+
+// Adds four boxes, held in the even 32-bit lanes, to the totals.
+__attribute__((target("avx2")))
+static void
+measure_lanes_avx2(__m256i l, __m256i w, __m256i h, __m256i shortest, __m256i second,
+                   __m256i *paper, __m256i *ribbon)
+{
+    const __m256i low_half = _mm256_set1_epi64x(UINT32_MAX);
+
+    __m256i lw = _mm256_mul_epu32(l, w);
+    __m256i areas = _mm256_add_epi64(lw, _mm256_add_epi64(_mm256_mul_epu32(w, h), _mm256_mul_epu32(h, l)));
+    __m256i box_paper = _mm256_add_epi64(_mm256_slli_epi64(areas, 1), _mm256_mul_epu32(shortest, second));
+
+    __m256i half_perimeter = _mm256_and_si256(_mm256_add_epi32(shortest, second), low_half);
+    __m256i box_ribbon = _mm256_add_epi64(_mm256_slli_epi64(half_perimeter, 1), volume_avx2(lw, h));
+
+    *paper = _mm256_add_epi64(*paper, box_paper);
+    *ribbon = _mm256_add_epi64(*ribbon, box_ribbon);
+}
+
+
+__attribute__((target("avx2")))
+static int64_t
+sum_lanes_avx2(__m256i total)
+{
+    __m128i pair = _mm_add_epi64(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+    int64_t result = _mm_cvtsi128_si64(pair) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(pair, pair));
+    return result;
+}
+
+
+__attribute__((target("avx2")))
+static void
+measure_boxes_avx2(const Boxes *boxes, Order *order)
+{
+    __m256i paper = _mm256_setzero_si256();
+    __m256i ribbon = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; (i + 8) <= boxes->count; i += 8)
+    {
+        __m256i l = _mm256_loadu_si256((const __m256i *)(boxes->l + i));
+        __m256i w = _mm256_loadu_si256((const __m256i *)(boxes->w + i));
+        __m256i h = _mm256_loadu_si256((const __m256i *)(boxes->h + i));
+
+        __m256i shortest = _mm256_min_epi32(l, w);
+        __m256i second = _mm256_min_epi32(_mm256_max_epi32(l, w), h);
+
+        measure_lanes_avx2(l, w, h, shortest, second, &paper, &ribbon);
+        measure_lanes_avx2(_mm256_srli_epi64(l, 32), _mm256_srli_epi64(w, 32), _mm256_srli_epi64(h, 32),
+                           _mm256_srli_epi64(shortest, 32), _mm256_srli_epi64(second, 32), &paper, &ribbon);
+    }
+
+    order->paper += sum_lanes_avx2(paper);
+    order->ribbon += sum_lanes_avx2(ribbon);
+
+    // the last few
+    for (; i < boxes->count; ++i)
+    {
+        measure_box(boxes->l[i], boxes->w[i], boxes->h[i], order);
+    }
+}
+
+#endif // AOC_X86
+
+
+#ifndef NDEBUG
+
+// A known answer for boxes whose areas don't fit 32 bits, enough of them to
+// fill the SIMD kernels' lanes.
+static bool
+measures_large_boxes(MeasureBoxes *measure)
+{
+    static const Boxes boxes = {
+        .count = 9,
+        .l = { 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000 },
+        .w = { 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000 },
+        .h = { 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000 },
+    };
+
+    Order order = {0};
+    measure(&boxes, &order);
+    bool result = (order.paper == (9 * 28000000)) && (order.ribbon == (9 * 8000008000));
+    return result;
+}
+
+#endif // NDEBUG
+
+
+static MeasureBoxes *
+select_measure_kernel(void)
+{
+    MeasureBoxes *result = measure_boxes_scalar;
+
+#if AOC_X86
+    __builtin_cpu_init();
+    if (!force_scalar && __builtin_cpu_supports("avx2"))
+    {
+        result = measure_boxes_avx2;
+    }
+#endif
+
+    return result;
+}
+
+
+// Works out both the wrapping paper and ribbon in one pass over the boxes.
+static Order
+order_range(const char *input, size_t length, MeasureBoxes *measure)
+{
+    BoxParser parser;
+    init_box_parser(&parser, input, length);
+
+    Order result = {0};
+    Boxes boxes;
+    do
+    {
+        boxes.count = 0;
+        parser.parse(&parser, &boxes);
+        measure(&boxes, &result);
+    } while (boxes.count > 0);
+
+    return result;
+}
+
+
+// Parallel reduction
+//
+// Large inputs are split into a chunk of whole lines per worker, each ordered
+// independently, and the orders added up.
+//
+
+typedef struct OrderChunks
+{
+    MeasureBoxes *measure;
+    Order orders[MAX_WORKERS];
+} OrderChunks;
+
+
+static void
+order_chunk(const char *input, size_t length, void *data, uint32_t chunk)
+{
+    OrderChunks *chunks = data;
+    chunks->orders[chunk] = order_range(input, length, chunks->measure);
+}
+
+
+static Order
+order_supplies(const char *input, size_t length)
+{
+    uint32_t nchunks = input_chunk_count(length);
+
+    // The kernel is picked, and checked, once for all the chunks.
+    OrderChunks chunks;
+    chunks.measure = select_measure_kernel();
+    assert(measures_large_boxes(chunks.measure));
+    run_parallel_lines(order_chunk, &chunks, input, length, nchunks);
+
+    Order result = {0};
+    for (uint32_t i = 0; i < nchunks; ++i)
+    {
+        result.paper += chunks.orders[i].paper;
+        result.ribbon += chunks.orders[i].ribbon;
+    }
+
+    return result;
+}
+
+
+static int64_t
+part1(const char *input, size_t length)
+{
+    Order order = order_supplies(input, length);
+    return order.paper;
+}
+
+
+static int64_t
+part2(const char *input, size_t length)
+{
+    Order order = order_supplies(input, length);
+    return order.ribbon;
+}
+
+
+static void
+solve(const char *input, size_t length, int64_t answers[2])
+{
+    Order order = order_supplies(input, length);
+    answers[0] = order.paper;
+    answers[1] = order.ribbon;
+}
+
+
 #if 0
+static void
+test_day02(void)
+{
+#define ARRAY_SIZE(array) (sizeof(array)/sizeof(*(array)))
+
     typedef struct Test
     {
         const char *input;
-        int result;
+        int64_t paper;
+        int64_t ribbon;
     } Test;
 
     const Test tests[] = {
-        { "2x3x4", 58 },
-        { "1x1x10", 43 },
-        { "2x3x4\n1x1x10", 101 },
+        { "2x3x4", 58, 34 },
+        { "1x1x10", 43, 14 },
+        { "2x3x4\n1x1x10", 101, 48 },
     };
 
     for (size_t i = 0; i < ARRAY_SIZE(tests); ++i)
     {
         const Test *test = tests + i;
-        int result = day02(test->input);
-        printf("test %zu: %s: expected = %d, actual = %d\n", i, test->input, test->result, result);
+        size_t length = strlen(test->input);
+        int64_t paper = part1(test->input, length);
+        int64_t ribbon = part2(test->input, length);
+        printf("test %zu: %s: expected = %" PRId64 "/%" PRId64 ", actual = %" PRId64 "/%" PRId64 "\n",
+               i, test->input, test->paper, test->ribbon, paper, ribbon);
     }
+}
 #endif
-    puts("\nDay 02:");
 
-    int result = part1(input);
-    assert(result == 1586300);
-    printf("The elves need to order %d square feet of wrapping paper.\n", result);
 
-    result = part2(input);
-    assert(result == 3737498);
-    printf("The elves need to order %d feet of ribbon.\n", result);
-}
+const Day day02 = {
+    .name = "Day 02",
+    .filename = "day02.txt",
+    .parts = { part1, part2 },
+    .solve = solve,
+    .answers = { 1586300, 3737498 },
+    .reports = {
+        "The elves need to order %" PRId64 " square feet of wrapping paper.",
+        "The elves need to order %" PRId64 " feet of ribbon.",
+    },
+};
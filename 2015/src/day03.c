@@ -1,13 +1,20 @@
 #include "2015.h"
+#include "parallel.h"
 
 // stdlib
 #include <assert.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h> // calloc
+#include <stdlib.h>
+#include <string.h>
+
+#if AOC_X86
+#include <immintrin.h>
+#endif
 
 
 typedef union Position
@@ -21,24 +28,89 @@ typedef union Position
 } Position;
 
 
-typedef struct House
+// Scratch memory for a delivery's bitmap or set. Solving both parts hands the
+// same arena to each, so it's only allocated (and its pages faulted in) once.
+typedef struct Arena
 {
-    Position position;
-    uint32_t hash;
-    bool visited;
-} House;
+    void *base;
+    size_t size;
+} Arena;
+
+#define ARENA_ALIGNMENT 64
+
+
+// Returns size zeroed, cache-line aligned bytes, valid until the next call.
+static void *
+reserve_zeroed(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (size > arena->size)
+    {
+        free(arena->base);
+        arena->base = aligned_alloc(ARENA_ALIGNMENT, size);
+        arena->size = size;
+        assert(arena->base);
+    }
+
+    void *result = arena->base;
+    memset(result, 0, size);
+    return result;
+}
+
+
+static void
+delete_arena(Arena *arena)
+{
+    free(arena->base);
+    arena->base = 0;
+    arena->size = 0;
+}
+
+
+// Visited houses are kept in an open-addressed set of positions, packed four
+// bytes to a key so a 64-byte cache line holds a group of 16 of them. A probe
+// hashes to a group and compares the key against the whole group at once,
+// moving on to the next group only if the group is full without it. Nothing is
+// ever removed, so a group fills from the front and the first empty slot ends
+// the search.
+//
+// Keys are positions with both halves flipped at the sign bit, which leaves 0
+// free to mark empty slots (so the table can start out zeroed). The one
+// position that maps to 0, the far corner at (INT16_MIN, INT16_MIN), is
+// tracked on its own.
+
+#define GROUP_SIZE 16
+#define EMPTY_KEY 0
+#define CORNER_KEY 0x80008000u
+// Fibonacci hashing: the top bits of key * 2^32/phi pick the group.
+#define HASH_MULTIPLIER 0x9e3779b1u
+
+#define GRID_MAX_LOAD 80
+#define GRID_INIT_CAPACITY (2 * GROUP_SIZE)
+// The set is sized up front for as many houses as the walk could visit, up to
+// this many slots, so it only grows for longer walks than that.
+#define GRID_MAX_PRESIZE (1 << 25)
+
+
+// Returns the slot holding key, or the empty slot it belongs in.
+typedef uint32_t FindSlot(const uint32_t *keys, uint32_t group_mask, uint32_t group, uint32_t key);
 
 
 typedef struct Grid
 {
     uint32_t used;
+    // Grows once used reaches this, so inserts needn't work out the load.
+    uint32_t grow_at;
     uint32_t capacity;
-    House *houses;
+    // 32 - log2(number of groups)
+    uint32_t shift;
+    bool corner_visited;
+    // Until the set outgrows the arena it starts in.
+    bool owns_keys;
+    uint32_t *keys;
+    FindSlot *find;
 } Grid;
 
-#define GRID_MAX_LOAD 80
-#define GRID_INIT_CAPACITY 8
-
 
 static bool
 is_power_of_two(uint32_t value)
@@ -48,20 +120,190 @@ is_power_of_two(uint32_t value)
 }
 
 
+static uint32_t
+house_key(Position position)
+{
+    uint32_t result = (uint32_t)position.paired ^ CORNER_KEY;
+    return result;
+}
+
+
+static uint32_t
+home_group(const Grid *grid, uint32_t key)
+{
+    uint32_t result = (key * HASH_MULTIPLIER) >> grid->shift;
+    return result;
+}
+
+
+// Without vectors, slots are checked one at a time, which finds the same slot
+// as checking whole groups as groups fill from the front.
+static uint32_t
+find_slot_scalar(const uint32_t *keys, uint32_t group_mask, uint32_t group, uint32_t key)
+{
+    uint32_t slot_mask = ((group_mask + 1) * GROUP_SIZE) - 1;
+    uint32_t result = group * GROUP_SIZE;
+    while ((keys[result] != key) && (keys[result] != EMPTY_KEY))
+    {
+        result = (result + 1) & slot_mask;
+    }
+
+    return result;
+}
+
+
+#if AOC_X86
+
+// MATCH(slots, key, found, empty) sets bit i of found if slots[i] is key, and
+// of empty if slots[i] is empty.
+#define DEFINE_FIND_SLOT(name, attributes) \
+    attributes \
+    static uint32_t \
+    name(const uint32_t *keys, uint32_t group_mask, uint32_t group, uint32_t key) \
+    { \
+        for (;;) \
+        { \
+            const uint32_t *slots = keys + ((size_t)group * GROUP_SIZE); \
+            uint32_t found; \
+            uint32_t empty; \
+            MATCH(slots, key, found, empty); \
+            \
+            uint32_t stop = found | empty; \
+            if (stop) \
+            { \
+                uint32_t result = (group * GROUP_SIZE) + (uint32_t)__builtin_ctz(stop); \
+                return result; \
+            } \
+            \
+            group = (group + 1) & group_mask; \
+        } \
+    }
+
+
+// The group is compared a vector at a time, and the lane masks put together.
+
+#define MATCH(slots, key, found, empty) \
+    __m128i wanted = _mm_set1_epi32((int)key); \
+    __m128i zero = _mm_setzero_si128(); \
+    found = 0; \
+    empty = 0; \
+    for (uint32_t i = 0; i < GROUP_SIZE; i += 4) \
+    { \
+        __m128i chunk = _mm_load_si128((const __m128i *)(const void *)(slots + i)); \
+        found |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, wanted))) << i; \
+        empty |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, zero))) << i; \
+    }
+
+DEFINE_FIND_SLOT(find_slot_sse2, __attribute__((target("sse2"))))
+
+#undef MATCH
+
+
+#define MATCH(slots, key, found, empty) \
+    __m256i wanted = _mm256_set1_epi32((int)key); \
+    __m256i zero = _mm256_setzero_si256(); \
+    found = 0; \
+    empty = 0; \
+    for (uint32_t i = 0; i < GROUP_SIZE; i += 8) \
+    { \
+        __m256i chunk = _mm256_load_si256((const __m256i *)(const void *)(slots + i)); \
+        found |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, wanted))) << i; \
+        empty |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, zero))) << i; \
+    }
+
+DEFINE_FIND_SLOT(find_slot_avx2, __attribute__((target("avx2"))))
+
+#undef MATCH
+
+
+// The whole group in one compare.
+#define MATCH(slots, key, found, empty) \
+    __m512i chunk = _mm512_load_si512(slots); \
+    found = _mm512_cmpeq_epi32_mask(chunk, _mm512_set1_epi32((int)key)); \
+    empty = _mm512_testn_epi32_mask(chunk, chunk);
+
+DEFINE_FIND_SLOT(find_slot_avx512, __attribute__((target("avx512f"))))
+
+#undef MATCH
+
+#undef DEFINE_FIND_SLOT
+
+#endif // AOC_X86
+
+
+static FindSlot *
+select_find_kernel(void)
+{
+    FindSlot *result = find_slot_scalar;
+
+#if AOC_X86
+    __builtin_cpu_init();
+    if (force_scalar)
+    {
+        // keep the scalar kernel
+    }
+    else if (__builtin_cpu_supports("avx512f"))
+    {
+        result = find_slot_avx512;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        result = find_slot_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        result = find_slot_sse2;
+    }
+#endif
+
+    return result;
+}
+
+
+static void
+size_grid(Grid *grid, uint32_t capacity)
+{
+    assert(is_power_of_two(capacity) && (capacity >= GRID_INIT_CAPACITY));
+    grid->capacity = capacity;
+    grid->grow_at = (uint32_t)(((uint64_t)capacity * GRID_MAX_LOAD) / 100);
+    grid->shift = 32 - (uint32_t)__builtin_ctz(capacity / GROUP_SIZE);
+}
+
+
+// Enough slots to hold max_houses below the maximum load.
+static uint32_t
+presize_capacity(uint64_t max_houses)
+{
+    uint32_t result = GRID_INIT_CAPACITY;
+    while ((result < GRID_MAX_PRESIZE) && ((((uint64_t)result * GRID_MAX_LOAD) / 100) <= max_houses))
+    {
+        result *= 2;
+    }
+
+    return result;
+}
+
+
 static void
-init_grid(Grid *grid)
+init_grid(Grid *grid, Arena *arena, uint64_t max_houses)
 {
     grid->used = 0;
-    grid->capacity = GRID_INIT_CAPACITY;
-    grid->houses = calloc(8, sizeof(*grid->houses));
-    assert(grid->houses);
+    grid->corner_visited = false;
+    grid->owns_keys = false;
+    grid->find = select_find_kernel();
+    size_grid(grid, presize_capacity(max_houses));
+    grid->keys = reserve_zeroed(arena, (size_t)grid->capacity * sizeof(*grid->keys));
 }
 
 
 static void
 delete_grid(Grid *grid)
 {
-    free(grid->houses);
+    if (grid->owns_keys)
+    {
+        free(grid->keys);
+    }
+    grid->keys = 0;
     grid->used = 0;
     grid->capacity = 0;
 }
@@ -71,145 +313,556 @@ static void
 grow_grid(Grid *grid)
 {
     assert(grid->capacity < (UINT32_MAX / 2));
-    uint32_t capacity = grid->capacity * 2;
-    uint32_t mask = capacity - 1;
+    uint32_t *keys = grid->keys;
+    uint32_t capacity = grid->capacity;
+    size_grid(grid, capacity * 2);
 
-    House *houses = calloc(capacity, sizeof(*grid->houses));
-    assert(houses);
+    // Groups are cache-line aligned, and start out empty.
+    size_t size = (size_t)grid->capacity * sizeof(*grid->keys);
+    grid->keys = aligned_alloc(ARENA_ALIGNMENT, size);
+    assert(grid->keys);
+    memset(grid->keys, EMPTY_KEY, size);
 
-    for (uint32_t i = 0; i < grid->capacity; ++i)
+    uint32_t group_mask = (grid->capacity / GROUP_SIZE) - 1;
+    for (uint32_t i = 0; i < capacity; ++i)
     {
-        House *from = grid->houses + i;
-        if (from->visited)
+        uint32_t key = keys[i];
+        if (key != EMPTY_KEY)
         {
-            uint32_t index = from->hash & mask;
-            House *to = houses + index;
-            while (to->visited)
+            uint32_t slot = grid->find(grid->keys, group_mask, home_group(grid, key), key);
+            grid->keys[slot] = key;
+        }
+    }
+
+    if (grid->owns_keys)
+    {
+        free(keys);
+    }
+    grid->owns_keys = true;
+}
+
+
+// Adds a house at the group hashed to earlier, unless the set has grown since.
+static void
+visit_key(Grid *grid, uint32_t key, uint32_t group, uint32_t capacity)
+{
+    if (key == EMPTY_KEY)
+    {
+        grid->used += !grid->corner_visited;
+        grid->corner_visited = true;
+    }
+    else
+    {
+        group = (capacity == grid->capacity) ? group : home_group(grid, key);
+        uint32_t group_mask = (grid->capacity / GROUP_SIZE) - 1;
+        uint32_t slot = grid->find(grid->keys, group_mask, group, key);
+        if (grid->keys[slot] == EMPTY_KEY)
+        {
+            grid->keys[slot] = key;
+            if (++grid->used >= grid->grow_at)
             {
-                index = (index + 1) & mask;
-                to = houses + index;
+                grow_grid(grid);
             }
-            *to = *from;
         }
     }
+}
 
-    free(grid->houses);
-    grid->capacity = capacity;
-    grid->houses = houses;
+
+static void
+visit_house(Grid *grid, Position position)
+{
+    uint32_t key = house_key(position);
+    visit_key(grid, key, home_group(grid, key), grid->capacity);
 }
 
 
-static uint32_t
-hash_number(int32_t value)
+//
+// Tracing
+//
+// Moves are taken a block at a time and turned into each santa's position
+// after every move, relative to where they were before the block, along with
+// the box the block kept to. Every byte is a turn, even if it isn't a move.
+// With two santas, Santa takes the even moves and Robo-Santa the odd ones, and
+// blocks are an even number of moves, so the same santa always starts a block.
+//
+// Positions within a block are small, so they can be worked out in 16 bits
+// whatever the walk is doing, and each use adds them to its own kind of base.
+
+#define TRACE_BLOCK 64
+
+
+typedef struct Trace
 {
-    // Hash using FNV-1a hash
-    union
+    int16_t x[TRACE_BLOCK];
+    int16_t y[TRACE_BLOCK];
+    // The box kept to over the even moves and over the odd ones, which also
+    // covers the position before the block.
+    int16_t min_x[2];
+    int16_t max_x[2];
+    int16_t min_y[2];
+    int16_t max_y[2];
+} Trace;
+
+
+// Traces a full block of moves.
+typedef void TraceMoves(const char *moves, uint32_t nsantas, Trace *trace);
+
+
+// Without vectors, a position packs x and y into the halves of a word, each
+// biased by 2^15 so the few steps a block takes can't borrow from or carry
+// into the other half, and each move adds a step from a table.
+#define TRACE_BIAS 0x8000
+
+static const uint32_t trace_steps[256] = {
+    ['>'] = 1,
+    ['<'] = UINT32_MAX,
+    ['^'] = 1 << 16,
+    ['v'] = (uint32_t)-(1 << 16),
+};
+
+
+static void
+untrace_position(uint32_t position, int16_t *x, int16_t *y)
+{
+    *x = (int16_t)((int32_t)(position & 0xffff) - TRACE_BIAS);
+    *y = (int16_t)((int32_t)(position >> 16) - TRACE_BIAS);
+}
+
+
+static void
+trace_moves_scalar(const char *moves, uint32_t nsantas, Trace *trace)
+{
+    const unsigned char *bytes = (const unsigned char *)moves;
+    uint32_t start = ((uint32_t)TRACE_BIAS << 16) | TRACE_BIAS;
+    if (nsantas == 1)
+    {
+        uint32_t santa = start;
+        for (uint32_t i = 0; i < TRACE_BLOCK; ++i)
+        {
+            santa += trace_steps[bytes[i]];
+            untrace_position(santa, trace->x + i, trace->y + i);
+        }
+    }
+    else
     {
-        unsigned char bytes[4];
-        int32_t word;
-    } data = { .word = value };
+        uint32_t santa = start;
+        uint32_t robosanta = start;
+        for (uint32_t i = 0; i < TRACE_BLOCK; i += 2)
+        {
+            santa += trace_steps[bytes[i]];
+            robosanta += trace_steps[bytes[i + 1]];
+            untrace_position(santa, trace->x + i, trace->y + i);
+            untrace_position(robosanta, trace->x + i + 1, trace->y + i + 1);
+        }
+    }
 
-    uint32_t hash = 2166136261; // FNV offset basis
-    for (size_t i = 0; i < sizeof(data.bytes); ++i)
+    // The box is found in a second pass, which keeps the walk itself short.
+    for (uint32_t parity = 0; parity < 2; ++parity)
     {
-        hash ^= data.bytes[i];
-        hash *= 16777619; // FNV prime
+        int16_t min_x = 0;
+        int16_t max_x = 0;
+        int16_t min_y = 0;
+        int16_t max_y = 0;
+        for (uint32_t i = parity; i < TRACE_BLOCK; i += 2)
+        {
+            min_x = (trace->x[i] < min_x) ? trace->x[i] : min_x;
+            max_x = (trace->x[i] > max_x) ? trace->x[i] : max_x;
+            min_y = (trace->y[i] < min_y) ? trace->y[i] : min_y;
+            max_y = (trace->y[i] > max_y) ? trace->y[i] : max_y;
+        }
+
+        trace->min_x[parity] = min_x;
+        trace->max_x[parity] = max_x;
+        trace->min_y[parity] = min_y;
+        trace->max_y[parity] = max_y;
     }
+}
+
+
+#if AOC_X86
+
+// Sixteen moves at a time. The low nibble of c ^ (c >> 4) tells the four moves
+// apart, so one shuffle looks up each byte's step in x and another its step in
+// y, and a third looks up the move the nibble stands for, so other bytes that
+// share a nibble with a move can be told apart and given no step.
+//
+// Steps are summed across the vector in log2(16) shifted adds. With two
+// santas the shifts start at two bytes, so the even and odd lanes sum up
+// separately. The sums are widened to 16 bits and carried on from each
+// santa's last lane in the vector before.
+
+__attribute__((target("ssse3")))
+static void
+reduce_parity_ssse3(__m128i min, __m128i max, int16_t *mins, int16_t *maxes)
+{
+    // Fold the 32-bit pairs of lanes together, leaving the even lanes' result
+    // in lane 0 and the odd lanes' in lane 1.
+    min = _mm_min_epi16(min, _mm_shuffle_epi32(min, 0x4e));
+    min = _mm_min_epi16(min, _mm_shuffle_epi32(min, 0xb1));
+    max = _mm_max_epi16(max, _mm_shuffle_epi32(max, 0x4e));
+    max = _mm_max_epi16(max, _mm_shuffle_epi32(max, 0xb1));
 
-    return hash;
+    mins[0] = (int16_t)_mm_extract_epi16(min, 0);
+    mins[1] = (int16_t)_mm_extract_epi16(min, 1);
+    maxes[0] = (int16_t)_mm_extract_epi16(max, 0);
+    maxes[1] = (int16_t)_mm_extract_epi16(max, 1);
 }
 
 
+__attribute__((target("ssse3")))
 static void
-visit_house(Grid *grid, Position position)
+trace_moves_ssse3(const char *moves, uint32_t nsantas, Trace *trace)
 {
-    uint32_t hash = hash_number(position.paired);
+    // Indexed by the low nibble of c ^ (c >> 4): '^' is 0xb, 'v' 0x1, '<' 0xf
+    // and '>' 0xd.
+    const __m128i symbols = _mm_setr_epi8(0, 'v', 0, 0, 0, 0, 0, 0, 0, 0, 0, '^', 0, '>', 0, '<');
+    const __m128i steps_x = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, -1);
+    const __m128i steps_y = _mm_setr_epi8(0, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0);
 
-    assert(is_power_of_two(grid->capacity));
-    uint32_t mask = grid->capacity - 1;
-    uint32_t index = hash & mask;
+    __m128i carry_x = _mm_setzero_si128();
+    __m128i carry_y = _mm_setzero_si128();
+    __m128i min_x = _mm_setzero_si128();
+    __m128i max_x = _mm_setzero_si128();
+    __m128i min_y = _mm_setzero_si128();
+    __m128i max_y = _mm_setzero_si128();
 
-    House *house = grid->houses + index;
-    while (house->visited && (house->position.paired != position.paired))
+    for (uint32_t i = 0; i < TRACE_BLOCK; i += 16)
     {
-        index = (index + 1) & mask;
-        house = grid->houses + index;
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)(moves + i));
+        __m128i nibbles = _mm_and_si128(_mm_xor_si128(chunk, _mm_srli_epi16(chunk, 4)), _mm_set1_epi8(0x0f));
+        __m128i is_move = _mm_cmpeq_epi8(chunk, _mm_shuffle_epi8(symbols, nibbles));
+
+        __m128i x = _mm_and_si128(_mm_shuffle_epi8(steps_x, nibbles), is_move);
+        __m128i y = _mm_and_si128(_mm_shuffle_epi8(steps_y, nibbles), is_move);
+        if (nsantas == 1)
+        {
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+            y = _mm_add_epi8(y, _mm_slli_si128(y, 1));
+        }
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+        y = _mm_add_epi8(y, _mm_slli_si128(y, 2));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+        y = _mm_add_epi8(y, _mm_slli_si128(y, 4));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+        y = _mm_add_epi8(y, _mm_slli_si128(y, 8));
+
+        // Sign extend each half to 16 bits.
+        __m128i x_low = _mm_add_epi16(carry_x, _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8));
+        __m128i x_high = _mm_add_epi16(carry_x, _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8));
+        __m128i y_low = _mm_add_epi16(carry_y, _mm_srai_epi16(_mm_unpacklo_epi8(y, y), 8));
+        __m128i y_high = _mm_add_epi16(carry_y, _mm_srai_epi16(_mm_unpackhi_epi8(y, y), 8));
+
+        _mm_storeu_si128((__m128i *)(void *)(trace->x + i), x_low);
+        _mm_storeu_si128((__m128i *)(void *)(trace->x + i + 8), x_high);
+        _mm_storeu_si128((__m128i *)(void *)(trace->y + i), y_low);
+        _mm_storeu_si128((__m128i *)(void *)(trace->y + i + 8), y_high);
+
+        min_x = _mm_min_epi16(min_x, _mm_min_epi16(x_low, x_high));
+        max_x = _mm_max_epi16(max_x, _mm_max_epi16(x_low, x_high));
+        min_y = _mm_min_epi16(min_y, _mm_min_epi16(y_low, y_high));
+        max_y = _mm_max_epi16(max_y, _mm_max_epi16(y_low, y_high));
+
+        // Broadcast the last lane, or with two santas the last pair of lanes.
+        if (nsantas == 1)
+        {
+            carry_x = _mm_shuffle_epi32(_mm_shufflehi_epi16(x_high, 0xff), 0xff);
+            carry_y = _mm_shuffle_epi32(_mm_shufflehi_epi16(y_high, 0xff), 0xff);
+        }
+        else
+        {
+            carry_x = _mm_shuffle_epi32(x_high, 0xff);
+            carry_y = _mm_shuffle_epi32(y_high, 0xff);
+        }
+    }
+
+    reduce_parity_ssse3(min_x, max_x, trace->min_x, trace->max_x);
+    reduce_parity_ssse3(min_y, max_y, trace->min_y, trace->max_y);
+}
+
+#endif // AOC_X86
+
+
+static TraceMoves *
+select_trace_kernel(void)
+{
+    TraceMoves *result = trace_moves_scalar;
+
+#if AOC_X86
+    __builtin_cpu_init();
+    if (!force_scalar && __builtin_cpu_supports("ssse3"))
+    {
+        result = trace_moves_ssse3;
+    }
+#endif
+
+    return result;
+}
+
+
+// The walk, a block at a time. Zero bytes aren't moves, so the last block is
+// padded out with them.
+typedef struct Walk
+{
+    const char *input;
+    size_t length;
+    size_t done;
+    uint32_t nsantas;
+    TraceMoves *trace_moves;
+    char padded[TRACE_BLOCK];
+} Walk;
+
+
+static void
+start_walk(Walk *walk, const char *input, size_t length, uint32_t nsantas)
+{
+    assert((nsantas == 1) || (nsantas == 2));
+    walk->input = input;
+    walk->length = length;
+    walk->done = 0;
+    walk->nsantas = nsantas;
+    walk->trace_moves = select_trace_kernel();
+}
+
+
+// Traces the next block, returning how many of its moves are in the walk.
+static uint32_t
+next_block(Walk *walk, Trace *trace)
+{
+    size_t remaining = walk->length - walk->done;
+    const char *moves = walk->input + walk->done;
+    if (remaining < TRACE_BLOCK)
+    {
+        memset(walk->padded, 0, sizeof(walk->padded));
+        memcpy(walk->padded, moves, remaining);
+        moves = walk->padded;
     }
 
-    assert(!house->visited || (house->position.paired == position.paired));
-    if (!house->visited)
+    uint32_t result = (remaining < TRACE_BLOCK) ? (uint32_t)remaining : TRACE_BLOCK;
+    walk->done += result;
+    if (result)
     {
-        house->position = position;
-        house->hash = hash;
-        house->visited = true;
+        walk->trace_moves(moves, walk->nsantas, trace);
+    }
+
+    return result;
+}
+
+
+// The lane of a block holding a santa's last move in it. Padding doesn't move
+// anyone, so it's the same lane for the last block.
+static uint32_t
+last_lane(const Walk *walk, uint32_t santa)
+{
+    uint32_t result = TRACE_BLOCK - walk->nsantas + santa;
+    return result;
+}
+
+
+// The box a walk stays within, and how many moves it takes.
+typedef struct Bounds
+{
+    int64_t min_x;
+    int64_t max_x;
+    int64_t min_y;
+    int64_t max_y;
+    size_t nmoves;
+} Bounds;
+
 
-        ++grid->used;
-        if (((grid->used * 100) / grid->capacity) >= GRID_MAX_LOAD)
+// A random walk doesn't stray far for its length, so its box usually has few
+// enough cells per move to track them all in a bitmap.
+#define DENSE_CELLS_PER_MOVE 64
+#define DENSE_MAX_CELLS (1 << 28)
+
+
+// Where a santa got to over part of the walk, and the box they kept to, relative
+// to where they started it.
+typedef struct Extent
+{
+    int64_t x;
+    int64_t y;
+    int64_t min_x;
+    int64_t max_x;
+    int64_t min_y;
+    int64_t max_y;
+} Extent;
+
+
+static void
+trace_extents(const char *input, size_t length, uint32_t nsantas, Extent extents[2])
+{
+    extents[0] = (Extent){0};
+    extents[1] = (Extent){0};
+
+    Walk walk;
+    start_walk(&walk, input, length, nsantas);
+
+    Trace trace;
+    while (next_block(&walk, &trace))
+    {
+        // With one santa, the even and odd moves are both Santa's.
+        for (uint32_t parity = 0; parity < 2; ++parity)
+        {
+            Extent *extent = extents + (parity & (nsantas - 1));
+            int64_t min_x = extent->x + trace.min_x[parity];
+            int64_t max_x = extent->x + trace.max_x[parity];
+            int64_t min_y = extent->y + trace.min_y[parity];
+            int64_t max_y = extent->y + trace.max_y[parity];
+
+            extent->min_x = (min_x < extent->min_x) ? min_x : extent->min_x;
+            extent->max_x = (max_x > extent->max_x) ? max_x : extent->max_x;
+            extent->min_y = (min_y < extent->min_y) ? min_y : extent->min_y;
+            extent->max_y = (max_y > extent->max_y) ? max_y : extent->max_y;
+        }
+
+        for (uint32_t santa = 0; santa < nsantas; ++santa)
         {
-            grow_grid(grid);
+            extents[santa].x += trace.x[last_lane(&walk, santa)];
+            extents[santa].y += trace.y[last_lane(&walk, santa)];
         }
     }
 }
 
 
+// Widens bounds to take in an extent that started at (x, y).
 static void
-move(Position *position, char command)
+include_extent(Bounds *bounds, const Extent *extent, int64_t x, int64_t y)
 {
-    assert(position->x <= INT16_MAX);
-    assert(position->x >= INT16_MIN);
-    assert(position->y <= INT16_MAX);
-    assert(position->y >= INT16_MIN);
+    bounds->min_x = (x + extent->min_x < bounds->min_x) ? x + extent->min_x : bounds->min_x;
+    bounds->max_x = (x + extent->max_x > bounds->max_x) ? x + extent->max_x : bounds->max_x;
+    bounds->min_y = (y + extent->min_y < bounds->min_y) ? y + extent->min_y : bounds->min_y;
+    bounds->max_y = (y + extent->max_y > bounds->max_y) ? y + extent->max_y : bounds->max_y;
+}
 
-    position->x += (int16_t)((command == '>') - (command == '<'));
-    position->y += (int16_t)((command == '^') - (command == 'v'));
+
+static Bounds
+walk_bounds(const char *input, size_t length, uint32_t nsantas)
+{
+    Extent extents[2];
+    trace_extents(input, length, nsantas, extents);
+
+    Bounds result = { .nmoves = length };
+    for (uint32_t santa = 0; santa < nsantas; ++santa)
+    {
+        include_extent(&result, extents + santa, 0, 0);
+    }
+
+    return result;
 }
 
 
+static bool
+fits_dense(Bounds bounds)
+{
+    // Positions wrap at 16 bits, so a walk any wider than that must go in the
+    // grid to count the same.
+    uint64_t width = (uint64_t)(bounds.max_x - bounds.min_x) + 1;
+    uint64_t height = (uint64_t)(bounds.max_y - bounds.min_y) + 1;
+    uint64_t cells = width * height;
+
+    bool result = (width <= (UINT16_MAX + 1)) &&
+                  (height <= (UINT16_MAX + 1)) &&
+                  (cells <= DENSE_MAX_CELLS) &&
+                  (cells <= DENSE_CELLS_PER_MOVE * ((uint64_t)bounds.nmoves + 1));
+    return result;
+}
+
+
+// Each house is a bit in a bitmap covering the walk's bounding box, so a move is
+// just an add and a store, and the houses are counted once at the end.
 static uint32_t
-part1(const char *input)
+deliver_dense(const char *input, size_t length, uint32_t nsantas, Bounds bounds, Arena *arena)
 {
-    Grid grid;
-    init_grid(&grid);
+    size_t width = (size_t)(bounds.max_x - bounds.min_x) + 1;
+    size_t height = (size_t)(bounds.max_y - bounds.min_y) + 1;
+    size_t nwords = ((width * height) + 63) / 64;
 
-    Position santa = { .x = 0, .y = 0 };
-    visit_house(&grid, santa);
+    uint64_t *visited = reserve_zeroed(arena, nwords * sizeof(*visited));
 
-    while (*input)
+    size_t start = ((size_t)-bounds.min_y * width) + (size_t)-bounds.min_x;
+    size_t cells[2] = { start, start };
+    visited[start / 64] |= 1ull << (start % 64);
+
+    Walk walk;
+    start_walk(&walk, input, length, nsantas);
+
+    Trace trace;
+    uint32_t count;
+    while ((count = next_block(&walk, &trace)))
     {
-        char c = *input++;
-        move(&santa, c);
-        visit_house(&grid, santa);
+        // Unsigned, so moving down or left wraps around and back into the
+        // bitmap.
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ptrdiff_t offset = trace.x[i] + ((ptrdiff_t)trace.y[i] * (ptrdiff_t)width);
+            size_t cell = cells[i & (nsantas - 1)] + (size_t)offset;
+
+            assert(cell < width * height);
+            visited[cell / 64] |= 1ull << (cell % 64);
+        }
+
+        for (uint32_t santa = 0; santa < nsantas; ++santa)
+        {
+            uint32_t lane = last_lane(&walk, santa);
+            cells[santa] += (size_t)(trace.x[lane] + ((ptrdiff_t)trace.y[lane] * (ptrdiff_t)width));
+        }
     }
 
-    uint32_t result = grid.used;
-    delete_grid(&grid);
+    uint32_t result = 0;
+    for (size_t i = 0; i < nwords; ++i)
+    {
+        result += (uint32_t)__builtin_popcountll(visited[i]);
+    }
 
     return result;
 }
 
 
+// A block's houses are hashed together, and their groups fetched ahead of
+// being probed.
 static uint32_t
-part2(const char *input)
+deliver_sparse(const char *input, size_t length, uint32_t nsantas, Bounds bounds, Arena *arena)
 {
+    // Every move could find a new house.
     Grid grid;
-    init_grid(&grid);
+    init_grid(&grid, arena, (uint64_t)bounds.nmoves + 1);
 
-    Position santa = { .x = 0, .y = 0 };
-    Position robosanta = { .x = 0, .y = 0 };
-    visit_house(&grid, santa);
+    Position santas[2] = { { .x = 0, .y = 0 }, { .x = 0, .y = 0 } };
+    visit_house(&grid, santas[0]);
 
-    Position *this = &santa;
-    Position *next = &robosanta;
+    Walk walk;
+    start_walk(&walk, input, length, nsantas);
 
-    while (*input)
+    Trace trace;
+    uint32_t count;
+    while ((count = next_block(&walk, &trace)))
     {
-        char c = *input++;
-        move(this, c);
-        visit_house(&grid, *this);
+        uint32_t keys[TRACE_BLOCK];
+        uint32_t groups[TRACE_BLOCK];
+        uint32_t capacity = grid.capacity;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Position santa = santas[i & (nsantas - 1)];
+            Position position = {
+                .x = (int16_t)(santa.x + trace.x[i]),
+                .y = (int16_t)(santa.y + trace.y[i]),
+            };
+            keys[i] = house_key(position);
+            groups[i] = home_group(&grid, keys[i]);
+            __builtin_prefetch(grid.keys + ((size_t)groups[i] * GROUP_SIZE));
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            visit_key(&grid, keys[i], groups[i], capacity);
+        }
 
-        Position *temp = this;
-        this = next;
-        next = temp;
+        for (uint32_t santa = 0; santa < nsantas; ++santa)
+        {
+            uint32_t lane = last_lane(&walk, santa);
+            santas[santa].x = (int16_t)(santas[santa].x + trace.x[lane]);
+            santas[santa].y = (int16_t)(santas[santa].y + trace.y[lane]);
+        }
     }
 
     uint32_t result = grid.used;
@@ -219,16 +872,438 @@ part2(const char *input)
 }
 
 
-void
-day03(const char *input)
+//
+// Parallel counting
+//
+// Large inputs are split into one chunk per worker, each a whole number of
+// blocks so the santas take turns the same way in every chunk. Each worker
+// first traces its chunk's extents. Adding up the moves before a chunk then
+// gives where each santa starts it, and the extents together give the walk's
+// bounds.
+//
+// A dense bitmap is shared, and each worker walks its chunk through it. Most
+// moves revisit a house, so a worker only sets a bit, atomically, if it finds
+// it clear, and the workers rarely write to the same words.
+//
+// A set can't be shared like that, so it's split into shards and the houses
+// are counted a round at a time. Each worker traces the next part of its chunk
+// into keys and sorts them by shard. Then each worker takes a shard and adds
+// every worker's keys for it to the shard's set. A key always belongs to the
+// same shard, picked by a second hash independent of the one that picks its
+// group within the shard's set, so the shards never share a house, and the
+// count is the sum over the shards.
+//
+
+// How many moves the workers trace per round, between them. Each gets at least
+// the minimum.
+#define ROUND_MOVES (1 << 22)
+#define MIN_WORKER_ROUND_MOVES (1 << 14)
+#define SHARD_MULTIPLIER 0x85ebca6bu
+
+
+typedef struct WalkChunks
+{
+    const char *input;
+    size_t length;
+    size_t chunk_size;
+    // Both the number of chunks and the number of shards.
+    uint32_t nchunks;
+    uint32_t nsantas;
+    Extent extents[MAX_WORKERS][2];
+
+    // The dense bitmap, if the walk fits one.
+    bool dense;
+    atomic_uint_least64_t *visited;
+    size_t width;
+    size_t nwords;
+    // Or else each shard's set, in its own scratch memory.
+    Grid grids[MAX_WORKERS];
+    Arena arenas[MAX_WORKERS];
+
+    // Where each chunk's santas start, or have got to, as bitmap cells or
+    // positions.
+    size_t cells[MAX_WORKERS][2];
+    Position positions[MAX_WORKERS][2];
+
+    // Each worker's keys for the round, sorted by shard, and where each
+    // shard's start.
+    size_t round;
+    size_t round_moves;
+    uint32_t *keys;
+    uint8_t *key_shards;
+    uint32_t (*shard_starts)[MAX_WORKERS + 1];
+
+    uint32_t counts[MAX_WORKERS];
+} WalkChunks;
+
+
+static void
+extend_chunk(void *data, uint32_t worker)
+{
+    WalkChunks *chunks = data;
+    const char *input = chunks->input + (worker * chunks->chunk_size);
+    size_t length = chunk_length(chunks->length, chunks->chunk_size, worker);
+    trace_extents(input, length, chunks->nsantas, chunks->extents[worker]);
+}
+
+
+static void
+mark_cell(atomic_uint_least64_t *visited, size_t cell)
+{
+    uint64_t bit = 1ull << (cell % 64);
+    if (!(atomic_load_explicit(visited + (cell / 64), memory_order_relaxed) & bit))
+    {
+        atomic_fetch_or_explicit(visited + (cell / 64), bit, memory_order_relaxed);
+    }
+}
+
+
+static void
+visit_chunk_dense(void *data, uint32_t worker)
+{
+    WalkChunks *chunks = data;
+    uint32_t nsantas = chunks->nsantas;
+    ptrdiff_t width = (ptrdiff_t)chunks->width;
+    size_t *cells = chunks->cells[worker];
+
+    Walk walk;
+    size_t length = chunk_length(chunks->length, chunks->chunk_size, worker);
+    start_walk(&walk, chunks->input + (worker * chunks->chunk_size), length, nsantas);
+
+    Trace trace;
+    uint32_t count;
+    while ((count = next_block(&walk, &trace)))
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ptrdiff_t offset = trace.x[i] + ((ptrdiff_t)trace.y[i] * width);
+            mark_cell(chunks->visited, cells[i & (nsantas - 1)] + (size_t)offset);
+        }
+
+        for (uint32_t santa = 0; santa < nsantas; ++santa)
+        {
+            uint32_t lane = last_lane(&walk, santa);
+            cells[santa] += (size_t)(trace.x[lane] + ((ptrdiff_t)trace.y[lane] * width));
+        }
+    }
+}
+
+
+static uint32_t
+key_shard(const WalkChunks *chunks, uint32_t key)
+{
+    uint32_t result = (uint32_t)(((uint64_t)(key * SHARD_MULTIPLIER) * chunks->nchunks) >> 32);
+    return result;
+}
+
+
+// Traces this round's part of a chunk into keys, and sorts them by shard.
+static void
+scatter_keys(void *data, uint32_t worker)
+{
+    WalkChunks *chunks = data;
+    uint32_t nsantas = chunks->nsantas;
+
+    size_t length = 0;
+    size_t chunk = chunk_length(chunks->length, chunks->chunk_size, worker);
+    if (chunks->round < chunk)
+    {
+        length = chunk - chunks->round;
+        length = (length < chunks->round_moves) ? length : chunks->round_moves;
+    }
+
+    Walk walk;
+    start_walk(&walk, chunks->input + (worker * chunks->chunk_size) + chunks->round, length, nsantas);
+
+    uint32_t *keys = chunks->keys + (worker * chunks->round_moves);
+    uint8_t *shards = chunks->key_shards + (worker * chunks->round_moves);
+    Position *positions = chunks->positions[worker];
+    uint32_t nkeys = 0;
+
+    Trace trace;
+    uint32_t count;
+    while ((count = next_block(&walk, &trace)))
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Position santa = positions[i & (nsantas - 1)];
+            Position position = {
+                .x = (int16_t)(santa.x + trace.x[i]),
+                .y = (int16_t)(santa.y + trace.y[i]),
+            };
+            keys[nkeys] = house_key(position);
+            shards[nkeys] = (uint8_t)key_shard(chunks, keys[nkeys]);
+            ++nkeys;
+        }
+
+        for (uint32_t santa = 0; santa < nsantas; ++santa)
+        {
+            uint32_t lane = last_lane(&walk, santa);
+            positions[santa].x = (int16_t)(positions[santa].x + trace.x[lane]);
+            positions[santa].y = (int16_t)(positions[santa].y + trace.y[lane]);
+        }
+    }
+
+    // Counting sort, through this worker's part of the other half of the
+    // buffer.
+    uint32_t *starts = chunks->shard_starts[worker];
+    memset(starts, 0, sizeof(*chunks->shard_starts));
+    for (uint32_t i = 0; i < nkeys; ++i)
+    {
+        ++starts[shards[i] + 1];
+    }
+    for (uint32_t shard = 0; shard < chunks->nchunks; ++shard)
+    {
+        starts[shard + 1] += starts[shard];
+    }
+
+    uint32_t *sorted = chunks->keys + ((chunks->nchunks + worker) * chunks->round_moves);
+    uint32_t next[MAX_WORKERS];
+    memcpy(next, starts, chunks->nchunks * sizeof(*next));
+    for (uint32_t i = 0; i < nkeys; ++i)
+    {
+        sorted[next[shards[i]]++] = keys[i];
+    }
+    memcpy(keys, sorted, nkeys * sizeof(*keys));
+}
+
+
+// Adds every worker's keys for this worker's shard to its set.
+static void
+gather_keys(void *data, uint32_t shard)
+{
+    WalkChunks *chunks = data;
+    Grid *grid = chunks->grids + shard;
+    for (uint32_t worker = 0; worker < chunks->nchunks; ++worker)
+    {
+        const uint32_t *keys = chunks->keys + (worker * chunks->round_moves);
+        const uint32_t *starts = chunks->shard_starts[worker];
+        for (uint32_t i = starts[shard]; i < starts[shard + 1]; ++i)
+        {
+            visit_key(grid, keys[i], home_group(grid, keys[i]), grid->capacity);
+        }
+    }
+}
+
+
+static void
+count_shard(void *data, uint32_t shard)
+{
+    WalkChunks *chunks = data;
+    uint32_t result = 0;
+    if (chunks->dense)
+    {
+        // A shard is just a range of words to count.
+        size_t words_per_shard = (chunks->nwords + chunks->nchunks - 1) / chunks->nchunks;
+        size_t begin = shard * words_per_shard;
+        size_t end = begin + words_per_shard;
+        begin = (begin < chunks->nwords) ? begin : chunks->nwords;
+        end = (end < chunks->nwords) ? end : chunks->nwords;
+        for (size_t i = begin; i < end; ++i)
+        {
+            result += (uint32_t)__builtin_popcountll(atomic_load_explicit(chunks->visited + i, memory_order_relaxed));
+        }
+    }
+    else
+    {
+        result = chunks->grids[shard].used;
+        delete_grid(chunks->grids + shard);
+        delete_arena(chunks->arenas + shard);
+    }
+
+    chunks->counts[shard] = result;
+}
+
+
+static void
+deliver_parallel_dense(WalkChunks *chunks, Bounds bounds, Arena *arena)
+{
+    chunks->width = (size_t)(bounds.max_x - bounds.min_x) + 1;
+    size_t height = (size_t)(bounds.max_y - bounds.min_y) + 1;
+    chunks->nwords = ((chunks->width * height) + 63) / 64;
+    chunks->visited = reserve_zeroed(arena, chunks->nwords * sizeof(*chunks->visited));
+
+    size_t start = ((size_t)-bounds.min_y * chunks->width) + (size_t)-bounds.min_x;
+    mark_cell(chunks->visited, start);
+
+    run_parallel(visit_chunk_dense, chunks, chunks->nchunks);
+}
+
+
+static void
+deliver_parallel_sparse(WalkChunks *chunks)
+{
+    uint32_t nchunks = chunks->nchunks;
+
+    // Each shard is presized for its share of the houses, with some room to
+    // spare, but the shards between them presize no more than about one set
+    // would; they grow from there if the walk turns out to need it.
+    uint64_t max_houses = ((uint64_t)chunks->length + 1) / nchunks;
+    max_houses += max_houses / 8;
+
+    uint64_t max_presized = (((uint64_t)GRID_MAX_PRESIZE / nchunks) * GRID_MAX_LOAD) / 100;
+    if (max_houses >= max_presized)
+    {
+        max_houses = max_presized - 1;
+    }
+
+    for (uint32_t shard = 0; shard < nchunks; ++shard)
+    {
+        init_grid(chunks->grids + shard, chunks->arenas + shard, max_houses);
+    }
+
+    uint32_t key = house_key((Position){ .x = 0, .y = 0 });
+    Grid *grid = chunks->grids + key_shard(chunks, key);
+    visit_key(grid, key, home_group(grid, key), grid->capacity);
+
+    // Room for every worker's keys, and as much again to sort them in.
+    size_t round_moves = (ROUND_MOVES / nchunks) & ~(size_t)(TRACE_BLOCK - 1);
+    chunks->round_moves = (round_moves > MIN_WORKER_ROUND_MOVES) ? round_moves : MIN_WORKER_ROUND_MOVES;
+    chunks->keys = malloc(2 * nchunks * chunks->round_moves * sizeof(*chunks->keys));
+    chunks->key_shards = malloc(nchunks * chunks->round_moves * sizeof(*chunks->key_shards));
+    chunks->shard_starts = malloc(nchunks * sizeof(*chunks->shard_starts));
+    assert(chunks->keys && chunks->key_shards && chunks->shard_starts);
+
+    for (chunks->round = 0; chunks->round < chunks->chunk_size; chunks->round += chunks->round_moves)
+    {
+        run_parallel(scatter_keys, chunks, nchunks);
+        run_parallel(gather_keys, chunks, nchunks);
+    }
+
+    free(chunks->keys);
+    free(chunks->key_shards);
+    free(chunks->shard_starts);
+}
+
+
+static uint32_t
+deliver_parallel(const char *input, size_t length, uint32_t nsantas, uint32_t nchunks, Arena *arena)
+{
+    WalkChunks *chunks = calloc(1, sizeof(*chunks));
+    assert(chunks);
+    chunks->input = input;
+    chunks->length = length;
+    chunks->nchunks = nchunks;
+    chunks->nsantas = nsantas;
+
+    size_t chunk_size = (length + nchunks - 1) / nchunks;
+    chunks->chunk_size = (chunk_size + TRACE_BLOCK - 1) & ~(size_t)(TRACE_BLOCK - 1);
+
+    run_parallel(extend_chunk, chunks, nchunks);
+
+    // Where each chunk starts, and the walk's bounds.
+    int64_t x[MAX_WORKERS][2];
+    int64_t y[MAX_WORKERS][2];
+    Bounds bounds = { .nmoves = length };
+    for (uint32_t chunk = 0; chunk < nchunks; ++chunk)
+    {
+        for (uint32_t santa = 0; santa < nsantas; ++santa)
+        {
+            const Extent *before = chunk ? chunks->extents[chunk - 1] + santa : 0;
+            x[chunk][santa] = chunk ? x[chunk - 1][santa] + before->x : 0;
+            y[chunk][santa] = chunk ? y[chunk - 1][santa] + before->y : 0;
+            include_extent(&bounds, chunks->extents[chunk] + santa, x[chunk][santa], y[chunk][santa]);
+        }
+    }
+
+    // Only a dense walk is small enough to number its cells.
+    chunks->dense = fits_dense(bounds);
+    int64_t width = bounds.max_x - bounds.min_x + 1;
+    for (uint32_t chunk = 0; chunk < nchunks; ++chunk)
+    {
+        for (uint32_t santa = 0; santa < nsantas; ++santa)
+        {
+            if (chunks->dense)
+            {
+                int64_t cell = (x[chunk][santa] - bounds.min_x) + ((y[chunk][santa] - bounds.min_y) * width);
+                chunks->cells[chunk][santa] = (size_t)cell;
+            }
+            chunks->positions[chunk][santa].x = (int16_t)x[chunk][santa];
+            chunks->positions[chunk][santa].y = (int16_t)y[chunk][santa];
+        }
+    }
+
+    if (chunks->dense)
+    {
+        deliver_parallel_dense(chunks, bounds, arena);
+    }
+    else
+    {
+        deliver_parallel_sparse(chunks);
+    }
+
+    run_parallel(count_shard, chunks, nchunks);
+
+    uint32_t result = 0;
+    for (uint32_t shard = 0; shard < nchunks; ++shard)
+    {
+        result += chunks->counts[shard];
+    }
+
+    free(chunks);
+    return result;
+}
+
+
+static uint32_t
+deliver(const char *input, size_t length, uint32_t nsantas, Arena *arena)
+{
+    uint32_t nchunks = input_chunk_count(length);
+
+    uint32_t result = 0;
+    if (nchunks > 1)
+    {
+        result = deliver_parallel(input, length, nsantas, nchunks, arena);
+    }
+    else
+    {
+        Bounds bounds = walk_bounds(input, length, nsantas);
+        result = fits_dense(bounds) ? deliver_dense(input, length, nsantas, bounds, arena)
+                                    : deliver_sparse(input, length, nsantas, bounds, arena);
+    }
+
+    return result;
+}
+
+
+static int64_t
+part1(const char *input, size_t length)
 {
-    puts("\nDay 03:");
+    Arena arena = {0};
+    int64_t result = deliver(input, length, 1, &arena);
+    delete_arena(&arena);
+    return result;
+}
 
-    uint32_t result = part1(input);
-    assert(result == 2081);
-    printf("Santa delivers presents to %" PRIu32 " houses.\n", result);
 
-    result = part2(input);
-    assert(result == 2341);
-    printf("Santa and Robo-Santa deliver presents to %" PRIu32 " houses.\n", result);
+static int64_t
+part2(const char *input, size_t length)
+{
+    Arena arena = {0};
+    int64_t result = deliver(input, length, 2, &arena);
+    delete_arena(&arena);
+    return result;
 }
+
+
+static void
+solve(const char *input, size_t length, int64_t answers[2])
+{
+    Arena arena = {0};
+    answers[0] = deliver(input, length, 1, &arena);
+    answers[1] = deliver(input, length, 2, &arena);
+    delete_arena(&arena);
+}
+
+
+const Day day03 = {
+    .name = "Day 03",
+    .filename = "day03.txt",
+    .parts = { part1, part2 },
+    .solve = solve,
+    .answers = { 2081, 2341 },
+    .reports = {
+        "Santa delivers presents to %" PRId64 " houses.",
+        "Santa and Robo-Santa deliver presents to %" PRId64 " houses.",
+    },
+};
@@ -1,6 +1,11 @@
 #include "2015.h"
+#include "md5.h"
+#include "parallel.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -9,279 +14,692 @@
 
 typedef union Block
 {
-    char bytes[64];
-    uint32_t words[16];
+    char bytes[MD5_BLOCK_SIZE];
+    uint32_t words[MD5_BLOCK_SIZE / 4];
 } Block;
 
 
-static uint32_t T[] = {
-    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
-    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
-    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+// The longest final block that still has room for the padding and length.
+#define MAX_FINAL_LENGTH (MD5_BLOCK_SIZE - 1 - sizeof(uint64_t))
 
-    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
-    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
-    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
 
-    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
-    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
-    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+//
+// Multi-lane hashing
+//
+// Mining hashes millions of short, independent messages, so instead of
+// compressing one block at a time we compress one block from each of several
+// messages at once, one message per SIMD lane. Message words are stored
+// transposed (word-major) so each step loads one vector per word. Digests
+// never leave the vector registers: each kernel tests them against a mask of
+// the leading nibbles that must be zero and reports which lanes passed.
+//
+// All candidates share the same secret, so the lanes start from a midstate:
+// the digest of the secret's full blocks, advanced through the steps of the
+// final block that only read secret bytes.
+//
+
+#define MAX_LANES 16
 
-    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
-    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
-    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
-};
 
-static const unsigned char pad_bytes[64] = { 0x80 };
+typedef struct Lanes
+{
+    _Alignas(64) uint32_t words[16][MAX_LANES];
+} Lanes;
 
-static const uint32_t block_size = 64;
-static const uint32_t block_mask = block_size - 1;
 
+typedef struct Midstate
+{
+    // digest after all of the full blocks preceding the final block
+    uint32_t prefix[4];
+    // working state after the first `start` steps of the final block
+    uint32_t state[4];
+    uint32_t start;
+} Midstate;
+
+
+// Returns a bit for each lane whose digest has no bits set under `mask`.
+typedef uint32_t HashLanes(const Midstate *midstate, const uint32_t *mask, const Lanes *lanes);
+
+
+typedef struct LaneKernel
+{
+    uint32_t count;
+    HashLanes *hash;
+} LaneKernel;
 
+
+// Advances the midstate through the first `nwords` steps of round 1, which
+// read only the first `nwords` words of the final block.
 static void
-hash_block(uint32_t *block, uint32_t *digest)
+prepare_midstate(Midstate *midstate, const Block *block, uint32_t nwords)
 {
-    uint32_t A = digest[0];
-    uint32_t B = digest[1];
-    uint32_t C = digest[2];
-    uint32_t D = digest[3];
-
-#define ROUND(a, b, c, d, k, s, i) \
-    a += F(b, c, d) + block[k] + T[i]; \
-    a = ROTATE_LEFT(a, s); \
-    a += b
-
-#define ROTATE_LEFT(value, amount) (value << amount) | (value >> (32 - amount))
-
-    // round 1
-#define F(x, y, z) ((x & y) | ((~x) & z))
-    ROUND(A, B, C, D,  0,  7,  0);
-    ROUND(D, A, B, C,  1, 12,  1);
-    ROUND(C, D, A, B,  2, 17,  2);
-    ROUND(B, C, D, A,  3, 22,  3);
-
-    ROUND(A, B, C, D,  4,  7,  4);
-    ROUND(D, A, B, C,  5, 12,  5);
-    ROUND(C, D, A, B,  6, 17,  6);
-    ROUND(B, C, D, A,  7, 22,  7);
-
-    ROUND(A, B, C, D,  8,  7,  8);
-    ROUND(D, A, B, C,  9, 12,  9);
-    ROUND(C, D, A, B, 10, 17, 10);
-    ROUND(B, C, D, A, 11, 22, 11);
-
-    ROUND(A, B, C, D, 12,  7, 12);
-    ROUND(D, A, B, C, 13, 12, 13);
-    ROUND(C, D, A, B, 14, 17, 14);
-    ROUND(B, C, D, A, 15, 22, 15);
-#undef F
-
-    // round 2
-#define F(x, y, z) ((x & z) | (y & (~z)))
-    ROUND(A, B, C, D,  1,   5,  16);
-    ROUND(D, A, B, C,  6,   9,  17);
-    ROUND(C, D, A, B, 11,  14,  18);
-    ROUND(B, C, D, A,  0,  20,  19);
-
-    ROUND(A, B, C, D,  5,   5,  20);
-    ROUND(D, A, B, C, 10,   9,  21);
-    ROUND(C, D, A, B, 15,  14,  22);
-    ROUND(B, C, D, A,  4,  20,  23);
-
-    ROUND(A, B, C, D,  9,   5,  24);
-    ROUND(D, A, B, C, 14,   9,  25);
-    ROUND(C, D, A, B,  3,  14,  26);
-    ROUND(B, C, D, A,  8,  20,  27);
-
-    ROUND(A, B, C, D, 13,   5,  28);
-    ROUND(D, A, B, C,  2,   9,  29);
-    ROUND(C, D, A, B,  7,  14,  30);
-    ROUND(B, C, D, A, 12,  20,  31);
-#undef F
-
-    // round 3
-#define F(x, y, z) (x ^ y ^ z)
-    ROUND(A, B, C, D,  5,   4,  32);
-    ROUND(D, A, B, C,  8,  11,  33);
-    ROUND(C, D, A, B, 11,  16,  34);
-    ROUND(B, C, D, A, 14,  23,  35);
-
-    ROUND(A, B, C, D,  1,   4,  36);
-    ROUND(D, A, B, C,  4,  11,  37);
-    ROUND(C, D, A, B,  7,  16,  38);
-    ROUND(B, C, D, A, 10,  23,  39);
-
-    ROUND(A, B, C, D, 13,   4,  40);
-    ROUND(D, A, B, C,  0,  11,  41);
-    ROUND(C, D, A, B,  3,  16,  42);
-    ROUND(B, C, D, A,  6,  23,  43);
-
-    ROUND(A, B, C, D,  9,   4,  44);
-    ROUND(D, A, B, C, 12,  11,  45);
-    ROUND(C, D, A, B, 15,  16,  46);
-    ROUND(B, C, D, A,  2,  23,  47);
-#undef F
-
-    // round 4
-#define F(x, y, z) (y ^ (x | (~z)))
-    ROUND(A, B, C, D,  0,   6,  48);
-    ROUND(D, A, B, C,  7,  10,  49);
-    ROUND(C, D, A, B, 14,  15,  50);
-    ROUND(B, C, D, A,  5,  21,  51);
-
-    ROUND(A, B, C, D, 12,   6,  52);
-    ROUND(D, A, B, C,  3,  10,  53);
-    ROUND(C, D, A, B, 10,  15,  54);
-    ROUND(B, C, D, A,  1,  21,  55);
-
-    ROUND(A, B, C, D,  8,   6,  56);
-    ROUND(D, A, B, C, 15,  10,  57);
-    ROUND(C, D, A, B,  6,  15,  58);
-    ROUND(B, C, D, A, 13,  21,  59);
-
-    ROUND(A, B, C, D,  4,   6,  60);
-    ROUND(D, A, B, C, 11,  10,  61);
-    ROUND(C, D, A, B,  2,  15,  62);
-    ROUND(B, C, D, A,  9,  21,  63);
-#undef F
-
-#undef ROUND
+    static const uint32_t shifts[4] = { 7, 12, 17, 22 };
+
+    assert(nwords < 16);
+    uint32_t state[4];
+    memcpy(state, midstate->prefix, sizeof(state));
+
+    for (uint32_t i = 0; i < nwords; ++i)
+    {
+        // Successive steps update A, D, C, B in turn.
+        uint32_t a = (4 - (i & 3)) & 3;
+        uint32_t x = state[(a + 1) & 3];
+        uint32_t y = state[(a + 2) & 3];
+        uint32_t z = state[(a + 3) & 3];
+
+        uint32_t value = state[a] + ((x & y) | (~x & z)) + block->words[i] + md5_table[i];
+        uint32_t s = shifts[i & 3];
+        state[a] = ((value << s) | (value >> (32 - s))) + x;
+    }
+
+    memcpy(midstate->state, state, sizeof(state));
+    midstate->start = nwords;
+}
+
+
+#define FALLTHROUGH __attribute__((fallthrough))
+
+// The 64 steps of the MD5 compression function, entered at round 1 step
+// `start`. Each kernel defines STEP, and the round functions F1-F4, in terms of
+// its own vector operations.
+#define MD5_STEPS_FROM(start) \
+    switch (start) \
+    { \
+        case  0: STEP(F1, A, B, C, D,  0,  7,  0); FALLTHROUGH; \
+        case  1: STEP(F1, D, A, B, C,  1, 12,  1); FALLTHROUGH; \
+        case  2: STEP(F1, C, D, A, B,  2, 17,  2); FALLTHROUGH; \
+        case  3: STEP(F1, B, C, D, A,  3, 22,  3); FALLTHROUGH; \
+        case  4: STEP(F1, A, B, C, D,  4,  7,  4); FALLTHROUGH; \
+        case  5: STEP(F1, D, A, B, C,  5, 12,  5); FALLTHROUGH; \
+        case  6: STEP(F1, C, D, A, B,  6, 17,  6); FALLTHROUGH; \
+        case  7: STEP(F1, B, C, D, A,  7, 22,  7); FALLTHROUGH; \
+        case  8: STEP(F1, A, B, C, D,  8,  7,  8); FALLTHROUGH; \
+        case  9: STEP(F1, D, A, B, C,  9, 12,  9); FALLTHROUGH; \
+        case 10: STEP(F1, C, D, A, B, 10, 17, 10); FALLTHROUGH; \
+        case 11: STEP(F1, B, C, D, A, 11, 22, 11); FALLTHROUGH; \
+        case 12: STEP(F1, A, B, C, D, 12,  7, 12); FALLTHROUGH; \
+        case 13: STEP(F1, D, A, B, C, 13, 12, 13); FALLTHROUGH; \
+        case 14: STEP(F1, C, D, A, B, 14, 17, 14); FALLTHROUGH; \
+        case 15: STEP(F1, B, C, D, A, 15, 22, 15); break; \
+        default: assert(false); break; \
+    } \
+    STEP(F2, A, B, C, D,  1,  5, 16); \
+    STEP(F2, D, A, B, C,  6,  9, 17); \
+    STEP(F2, C, D, A, B, 11, 14, 18); \
+    STEP(F2, B, C, D, A,  0, 20, 19); \
+    STEP(F2, A, B, C, D,  5,  5, 20); \
+    STEP(F2, D, A, B, C, 10,  9, 21); \
+    STEP(F2, C, D, A, B, 15, 14, 22); \
+    STEP(F2, B, C, D, A,  4, 20, 23); \
+    STEP(F2, A, B, C, D,  9,  5, 24); \
+    STEP(F2, D, A, B, C, 14,  9, 25); \
+    STEP(F2, C, D, A, B,  3, 14, 26); \
+    STEP(F2, B, C, D, A,  8, 20, 27); \
+    STEP(F2, A, B, C, D, 13,  5, 28); \
+    STEP(F2, D, A, B, C,  2,  9, 29); \
+    STEP(F2, C, D, A, B,  7, 14, 30); \
+    STEP(F2, B, C, D, A, 12, 20, 31); \
+    STEP(F3, A, B, C, D,  5,  4, 32); \
+    STEP(F3, D, A, B, C,  8, 11, 33); \
+    STEP(F3, C, D, A, B, 11, 16, 34); \
+    STEP(F3, B, C, D, A, 14, 23, 35); \
+    STEP(F3, A, B, C, D,  1,  4, 36); \
+    STEP(F3, D, A, B, C,  4, 11, 37); \
+    STEP(F3, C, D, A, B,  7, 16, 38); \
+    STEP(F3, B, C, D, A, 10, 23, 39); \
+    STEP(F3, A, B, C, D, 13,  4, 40); \
+    STEP(F3, D, A, B, C,  0, 11, 41); \
+    STEP(F3, C, D, A, B,  3, 16, 42); \
+    STEP(F3, B, C, D, A,  6, 23, 43); \
+    STEP(F3, A, B, C, D,  9,  4, 44); \
+    STEP(F3, D, A, B, C, 12, 11, 45); \
+    STEP(F3, C, D, A, B, 15, 16, 46); \
+    STEP(F3, B, C, D, A,  2, 23, 47); \
+    STEP(F4, A, B, C, D,  0,  6, 48); \
+    STEP(F4, D, A, B, C,  7, 10, 49); \
+    STEP(F4, C, D, A, B, 14, 15, 50); \
+    STEP(F4, B, C, D, A,  5, 21, 51); \
+    STEP(F4, A, B, C, D, 12,  6, 52); \
+    STEP(F4, D, A, B, C,  3, 10, 53); \
+    STEP(F4, C, D, A, B, 10, 15, 54); \
+    STEP(F4, B, C, D, A,  1, 21, 55); \
+    STEP(F4, A, B, C, D,  8,  6, 56); \
+    STEP(F4, D, A, B, C, 15, 10, 57); \
+    STEP(F4, C, D, A, B,  6, 15, 58); \
+    STEP(F4, B, C, D, A, 13, 21, 59); \
+    STEP(F4, A, B, C, D,  4,  6, 60); \
+    STEP(F4, D, A, B, C, 11, 10, 61); \
+    STEP(F4, C, D, A, B,  2, 15, 62); \
+    STEP(F4, B, C, D, A,  9, 21, 63);
+
+
+
+#define STEP(f, a, b, c, d, k, s, i) \
+    a = ADD(a, ADD(f(b, c, d), ADD(W[k], SET1(md5_table[i])))); \
+    a = ADD(ROTATE_LEFT(a, s), b)
+
+
+#define DEFINE_HASH_LANES(name, attributes) \
+    attributes \
+    static uint32_t \
+    name(const Midstate *midstate, const uint32_t *mask, const Lanes *lanes) \
+    { \
+        VECTOR W[16]; \
+        for (size_t i = 0; i < 16; ++i) \
+        { \
+            W[i] = LOAD(lanes->words[i]); \
+        } \
+        \
+        VECTOR A = SET1(midstate->state[0]); \
+        VECTOR B = SET1(midstate->state[1]); \
+        VECTOR C = SET1(midstate->state[2]); \
+        VECTOR D = SET1(midstate->state[3]); \
+        \
+        MD5_STEPS_FROM(midstate->start) \
+        \
+        A = AND(ADD(A, SET1(midstate->prefix[0])), SET1(mask[0])); \
+        B = AND(ADD(B, SET1(midstate->prefix[1])), SET1(mask[1])); \
+        C = AND(ADD(C, SET1(midstate->prefix[2])), SET1(mask[2])); \
+        D = AND(ADD(D, SET1(midstate->prefix[3])), SET1(mask[3])); \
+        \
+        uint32_t result = ZERO_LANES(OR(OR(A, B), OR(C, D))); \
+        return result; \
+    }
+
+
+// scalar: 1 lane
+#define VECTOR uint32_t
+#define LOAD(p) (*(p))
+#define AND(x, y) ((x) & (y))
+#define OR(x, y) ((x) | (y))
+#define ZERO_LANES(x) ((x) == 0)
+#define SET1(x) (x)
+#define ADD(x, y) ((x) + (y))
+#define ROTATE_LEFT(x, s) (((x) << (s)) | ((x) >> (32 - (s))))
+#define F1(x, y, z) ((x & y) | ((~x) & z))
+#define F2(x, y, z) ((x & z) | (y & (~z)))
+#define F3(x, y, z) (x ^ y ^ z)
+#define F4(x, y, z) (y ^ (x | (~z)))
+
+DEFINE_HASH_LANES(hash_lanes_scalar, )
+
+#undef VECTOR
+#undef LOAD
+#undef AND
+#undef OR
+#undef ZERO_LANES
+#undef SET1
+#undef ADD
+#undef ROTATE_LEFT
+#undef F1
+#undef F2
+#undef F3
+#undef F4
+
+
+#if AOC_X86
+
+#include <immintrin.h>
+
+// SSE2: 4 lanes
+#define VECTOR __m128i
+#define LOAD(p) _mm_load_si128((const __m128i *)(p))
+#define AND(x, y) _mm_and_si128(x, y)
+#define OR(x, y) _mm_or_si128(x, y)
+#define ZERO_LANES(x) (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, _mm_setzero_si128())))
+#define SET1(x) _mm_set1_epi32((int)(x))
+#define ADD(x, y) _mm_add_epi32(x, y)
+#define ROTATE_LEFT(x, s) _mm_or_si128(_mm_slli_epi32(x, s), _mm_srli_epi32(x, 32 - (s)))
+#define F1(x, y, z) _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z)))
+#define F2(x, y, z) _mm_xor_si128(y, _mm_and_si128(z, _mm_xor_si128(x, y)))
+#define F3(x, y, z) _mm_xor_si128(_mm_xor_si128(x, y), z)
+#define F4(x, y, z) _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, SET1(0xffffffff))))
+
+DEFINE_HASH_LANES(hash_lanes_sse2, __attribute__((target("sse2"))))
+
+#undef VECTOR
+#undef LOAD
+#undef AND
+#undef OR
+#undef ZERO_LANES
+#undef SET1
+#undef ADD
 #undef ROTATE_LEFT
+#undef F1
+#undef F2
+#undef F3
+#undef F4
+
+
+// AVX2: 8 lanes
+#define VECTOR __m256i
+#define LOAD(p) _mm256_load_si256((const __m256i *)(p))
+#define AND(x, y) _mm256_and_si256(x, y)
+#define OR(x, y) _mm256_or_si256(x, y)
+#define ZERO_LANES(x) (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, _mm256_setzero_si256())))
+#define SET1(x) _mm256_set1_epi32((int)(x))
+#define ADD(x, y) _mm256_add_epi32(x, y)
+#define ROTATE_LEFT(x, s) _mm256_or_si256(_mm256_slli_epi32(x, s), _mm256_srli_epi32(x, 32 - (s)))
+#define F1(x, y, z) _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z)))
+#define F2(x, y, z) _mm256_xor_si256(y, _mm256_and_si256(z, _mm256_xor_si256(x, y)))
+#define F3(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define F4(x, y, z) _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, SET1(0xffffffff))))
+
+DEFINE_HASH_LANES(hash_lanes_avx2, __attribute__((target("avx2"))))
+
+#undef VECTOR
+#undef LOAD
+#undef AND
+#undef OR
+#undef ZERO_LANES
+#undef SET1
+#undef ADD
+#undef ROTATE_LEFT
+#undef F1
+#undef F2
+#undef F3
+#undef F4
+
+
+// AVX-512: 16 lanes, with native rotates and each round function as a single
+// ternary-logic instruction.
+#define VECTOR __m512i
+#define LOAD(p) _mm512_load_si512(p)
+#define AND(x, y) _mm512_and_si512(x, y)
+#define OR(x, y) _mm512_or_si512(x, y)
+#define ZERO_LANES(x) (uint32_t)_mm512_testn_epi32_mask(x, x)
+#define SET1(x) _mm512_set1_epi32((int)(x))
+#define ADD(x, y) _mm512_add_epi32(x, y)
+#define ROTATE_LEFT(x, s) _mm512_rol_epi32(x, s)
+#define F1(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xca)
+#define F2(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xe4)
+#define F3(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+#define F4(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x39)
+
+DEFINE_HASH_LANES(hash_lanes_avx512, __attribute__((target("avx512f"))))
+
+#undef VECTOR
+#undef LOAD
+#undef AND
+#undef OR
+#undef ZERO_LANES
+#undef SET1
+#undef ADD
+#undef ROTATE_LEFT
+#undef F1
+#undef F2
+#undef F3
+#undef F4
+
+#endif // AOC_X86
+
+#undef DEFINE_HASH_LANES
+#undef STEP
+#undef MD5_STEPS_FROM
+#undef FALLTHROUGH
 
-    digest[0] += A;
-    digest[1] += B;
-    digest[2] += C;
-    digest[3] += D;
+
+static LaneKernel
+select_lane_kernel(void)
+{
+    LaneKernel result = { .count = 1, .hash = hash_lanes_scalar };
+
+#if AOC_X86
+    __builtin_cpu_init();
+    if (force_scalar)
+    {
+        // keep the scalar kernels
+    }
+    else if (__builtin_cpu_supports("avx512f"))
+    {
+        result.count = 16;
+        result.hash = hash_lanes_avx512;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        result.count = 8;
+        result.hash = hash_lanes_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        result.count = 4;
+        result.hash = hash_lanes_sse2;
+    }
+#endif
+
+    return result;
 }
 
 
+// Lays out the padding and length after the first `length` bytes of a final
+// block, for a message `message_length` bytes long in total.
 static void
-hash_md5(const char *input, size_t length, char *output)
+pad_final_block(Block *block, size_t length, uint64_t message_length)
 {
-    // The length in bits, truncated to 64 bits, is appended to the message.
-    uint64_t bit_length = (8 * length) & 0xffffffffffffffff;
+    assert(length <= MAX_FINAL_LENGTH);
+    uint64_t bit_length = 8 * message_length;
+
+    block->bytes[length] = (char)0x80;
+    memset(block->bytes + length + 1, 0, MAX_FINAL_LENGTH - length);
+    memcpy(block->bytes + MAX_FINAL_LENGTH + 1, &bit_length, sizeof(bit_length));
+}
 
-    // Pad the message with a '1' bit, some number of zero bits, and bit_length
-    // so the message is an exact multiple of 64 bytes (512 bits). The '1' bit
-    // and bit_length are always required.
-    size_t length_padded = (length + 1 + sizeof(bit_length) + block_mask) & ~block_mask;
-    size_t pad_length = length_padded - length - sizeof(bit_length);
 
-    union
-    {
-        unsigned char bytes[16];
-        uint32_t words[4];
-    } digest;
-
-    // initialization vectors
-    digest.words[0] = 0x67452301;
-    digest.words[1] = 0xefcdab89;
-    digest.words[2] = 0x98badcfe;
-    digest.words[3] = 0x10325476;
-
-    Block block;
-    while (length >= block_size)
+static const uint64_t powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+    10000000000,
+};
+
+
+static size_t
+count_digits(uint32_t number)
+{
+    size_t result = 1;
+    while (number >= powers_of_ten[result])
     {
-        memcpy(block.bytes, input, block_size);
-        length -= block_size;
-        input += block_size;
-        hash_block(block.words, digest.words);
+        ++result;
     }
 
-    assert(length < block_size);
-    memcpy(block.bytes, input, length);
-    size_t remaining = block_size - length;
+    return result;
+}
+
 
-    size_t pad_offset = 0;
-    if (pad_length > remaining)
+static void
+write_digits(char *output, uint32_t number, size_t digits)
+{
+    for (size_t i = digits; i > 0; --i)
     {
-        memcpy(block.bytes + length, pad_bytes, remaining);
-        length = 0;
-        pad_offset += remaining;
-        pad_length -= remaining;
-        hash_block(block.words, digest.words);
+        char c = (char)(number % 10) + '0';
+        number /= 10;
+        output[i - 1] = c;
     }
+}
 
-    memcpy(block.bytes + length, pad_bytes + pad_offset, pad_length);
-    memcpy(block.bytes + length + pad_length, &bit_length, sizeof(bit_length));
-    hash_block(block.words, digest.words);
 
-    const char bin2hex[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-    for (size_t i = 0, o = 0; i < sizeof(digest.bytes); ++i, o += 2)
+// Increments the ASCII number in place. A carry out of the leading digit is
+// dropped, so callers must not increment past the last number with `digits`
+// digits.
+static void
+increment_digits(char *number, size_t digits)
+{
+    for (char *digit = number + digits; digit-- > number;)
     {
-        unsigned char c = digest.bytes[i];
-        output[o] = bin2hex[(c >> 4) & 0xf];
-        output[o + 1] = bin2hex[c & 0xf];
+        if (*digit != '9')
+        {
+            ++*digit;
+            break;
+        }
+
+        *digit = '0';
     }
 }
 
 
+// Builds a mask over the digest words of the leading `nzeroes` hex digits.
 static void
-append_digits(char *input, size_t length, uint32_t number, size_t digits)
+leading_zeroes_mask(uint32_t nzeroes, uint32_t *mask)
 {
-    input[length + digits] = 0;
-    while (digits--)
+    assert(nzeroes <= 32);
+    memset(mask, 0, 4 * sizeof(*mask));
+
+    // Hex digit i is the high (even i) or low (odd i) nibble of digest byte
+    // i / 2, and digest words hold their bytes in little-endian order.
+    for (uint32_t i = 0; i < nzeroes; ++i)
     {
-        char c = (char)(number % 10) + '0';
-        number /= 10;
-        input[length + digits] = c;
+        uint32_t byte = i / 2;
+        uint32_t shift = 8 * (byte & 3) + ((i & 1) ? 0 : 4);
+        mask[byte / 4] |= 0xfu << shift;
     }
 }
 
 
+static bool
+has_zero_mask(const uint32_t *digest, const uint32_t *mask)
+{
+    uint32_t masked = (digest[0] & mask[0]) | (digest[1] & mask[1]) | (digest[2] & mask[2]) | (digest[3] & mask[3]);
+
+    bool result = masked == 0;
+    return result;
+}
+
+
+// Nonces are handed out to workers in chunks of this many candidates.
+#define MINING_CHUNK_SIZE (1 << 16)
+
+// Marks that no worker has found a coin yet.
+#define NO_COIN UINT32_MAX
+
+
+typedef struct Miner
+{
+    uint32_t mask[4];
+    LaneKernel kernel;
+
+    // The secret is absorbed once: its full blocks are hashed into the
+    // midstate's prefix and the rest of it starts every candidate's final
+    // block.
+    Md5 secret;
+    uint64_t prefix_length;
+    size_t tail_length;
+    Block tail;
+    Midstate midstate;
+
+    atomic_uint_fast32_t next_chunk;
+    atomic_uint_fast32_t result;
+} Miner;
+
+
+static void
+absorb_secret(Miner *miner, const char *secret, size_t length)
+{
+    md5_init(&miner->secret);
+    md5_update(&miner->secret, secret, length);
+
+    miner->tail_length = length & (MD5_BLOCK_SIZE - 1);
+    miner->prefix_length = length - miner->tail_length;
+    memcpy(miner->tail.bytes, miner->secret.buffer, miner->tail_length);
+
+    Midstate *midstate = &miner->midstate;
+    memcpy(midstate->prefix, miner->secret.state, sizeof(midstate->prefix));
+    prepare_midstate(midstate, &miner->tail, (uint32_t)(miner->tail_length / 4));
+}
+
+
+static bool
+is_abandoned(Miner *miner, uint32_t first)
+{
+    bool result = atomic_load(&miner->result) < first;
+    return result;
+}
+
+
+// Searches nonces in [first, last) and returns the smallest one that mines a
+// coin, or NO_COIN. The search is abandoned as soon as another worker has found
+// a coin smaller than `first`, since nothing in this range can then win.
 static uint32_t
-mine_advent_coins(const char *secret, size_t length, uint32_t nzeroes)
+search_range(Miner *miner, uint32_t first, uint32_t last)
 {
-    char input[128];
-    assert(length < sizeof(input));
-    memcpy(input, secret, length);
+    LaneKernel kernel = miner->kernel;
+    Lanes lanes;
+
+    size_t tail_length = miner->tail_length;
+
+    uint32_t result = first;
+    while ((result < last) && !is_abandoned(miner, first))
+    {
+        // Nonces with the same number of digits share a message layout, so
+        // the message is laid out once and only the nonce's digits change.
+        size_t digits = count_digits(result);
+        uint32_t end = last;
+        if (powers_of_ten[digits] < end)
+        {
+            end = (uint32_t)powers_of_ten[digits];
+        }
+
+        size_t length = tail_length + digits;
+        uint64_t message_length = miner->prefix_length + length;
+
+        if (length <= MAX_FINAL_LENGTH)
+        {
+            Block block = miner->tail;
+            char *nonce = block.bytes + tail_length;
+            write_digits(nonce, result, digits);
+            pad_final_block(&block, length, message_length);
+
+            for (size_t i = 0; i < 16; ++i)
+            {
+                for (uint32_t lane = 0; lane < kernel.count; ++lane)
+                {
+                    lanes.words[i][lane] = block.words[i];
+                }
+            }
+
+            // Only these words hold digits; the rest stay as laid out above.
+            size_t first_word = tail_length / 4;
+            size_t last_word = (length - 1) / 4;
+
+            while ((result < end) && !is_abandoned(miner, first))
+            {
+                uint32_t count = kernel.count;
+                if ((end - result) < count)
+                {
+                    count = end - result;
+                }
+
+                for (uint32_t lane = 0; lane < count; ++lane)
+                {
+                    for (size_t i = first_word; i <= last_word; ++i)
+                    {
+                        lanes.words[i][lane] = block.words[i];
+                    }
+                    increment_digits(nonce, digits);
+                }
+
+                uint32_t found = kernel.hash(&miner->midstate, miner->mask, &lanes);
+                found &= (1u << count) - 1;
+                if (found)
+                {
+                    return result + (uint32_t)__builtin_ctz(found);
+                }
+
+                result += count;
+            }
+        }
+        else
+        {
+            // The padding no longer fits in the final block, so fall back to
+            // hashing one candidate at a time.
+            char nonce[16];
+            assert((digits > 0) && (digits <= sizeof(nonce)));
+            write_digits(nonce, result, digits);
+
+            for (; (result < end) && !is_abandoned(miner, first); ++result)
+            {
+                Md5 md5 = miner->secret;
+                md5_update(&md5, nonce, digits);
+
+                union
+                {
+                    unsigned char bytes[MD5_DIGEST_SIZE];
+                    uint32_t words[4];
+                } digest;
+                md5_final(&md5, digest.bytes);
+
+                if (has_zero_mask(digest.words, miner->mask))
+                {
+                    return result;
+                }
+
+                increment_digits(nonce, digits);
+            }
+        }
+    }
 
-    uint32_t result = 0;
-    size_t digits = 1;
-    size_t next_digit = 10;
+    return NO_COIN;
+}
 
-    char digest[32];
 
-    uint32_t index;
-    do
+static void
+mine_chunks(void *data, uint32_t worker)
+{
+    (void)worker;
+    Miner *miner = data;
+
+    for (;;)
     {
-        ++result;
-        if (result == next_digit)
+        uint_fast32_t chunk = atomic_fetch_add(&miner->next_chunk, 1);
+        assert(chunk < (UINT32_MAX / MINING_CHUNK_SIZE));
+        uint32_t first = (uint32_t)(chunk * MINING_CHUNK_SIZE);
+        uint32_t last = first + MINING_CHUNK_SIZE;
+
+        // Chunks are handed out in increasing order, so once a coin has been
+        // found below this chunk every later chunk can be skipped as well.
+        uint_fast32_t found = atomic_load(&miner->result);
+        if (found < first)
         {
-            ++digits;
-            assert((length + digits) < sizeof(input));
-            next_digit *= 10;
+            break;
         }
-        append_digits(input, length, result, digits);
 
-        hash_md5(input, length + digits, digest);
-        index = 0;
-        while ((digest[index] == '0') && (++index < nzeroes));
-    } while (index < nzeroes);
+        // Nonces start at 1.
+        uint32_t coin = search_range(miner, first ? first : 1, last);
+        while ((coin < found) && !atomic_compare_exchange_weak(&miner->result, &found, coin));
+    }
+}
+
+
+static uint32_t
+mine_advent_coins(const char *secret, size_t length, uint32_t nzeroes)
+{
+    Miner miner = { .kernel = select_lane_kernel() };
+    leading_zeroes_mask(nzeroes, miner.mask);
+    absorb_secret(&miner, secret, length);
+    atomic_init(&miner.next_chunk, 0);
+    atomic_init(&miner.result, NO_COIN);
 
+    run_parallel(mine_chunks, &miner, worker_count());
+
+    uint32_t result = (uint32_t)atomic_load(&miner.result);
+    assert(result != NO_COIN);
     return result;
 }
 
 
-void
-day04(void)
+static size_t
+trim_secret(const char *input, size_t length)
 {
-    puts("\nDay 04:");
-
-    uint32_t nzeroes = 5;
-    const char *input = "iwrupvqb";
-    uint32_t result = mine_advent_coins(input, strlen(input), nzeroes);
-    assert(result == 346386);
-    printf("Santa's secret number for %u zeroes is %u.\n", nzeroes, result);
-
-#if 0
-    nzeroes = 6;
-    result = mine_advent_coins(input, strlen(input), nzeroes);
-    assert(result == 9958218);
-    printf("Santa's secret number for %u zeroes is %u.\n", nzeroes, result);
-#endif
+    // Ignore the line ending of a secret read from a file.
+    while (length && isspace((unsigned char)input[length - 1]))
+    {
+        --length;
+    }
+
+    return length;
+}
+
+
+static int64_t
+part1(const char *input, size_t length)
+{
+    uint32_t result = mine_advent_coins(input, trim_secret(input, length), 5);
+    return result;
 }
+
+
+static int64_t
+part2(const char *input, size_t length)
+{
+    uint32_t result = mine_advent_coins(input, trim_secret(input, length), 6);
+    return result;
+}
+
+
+const Day day04 = {
+    .name = "Day 04",
+    .builtin_input = "iwrupvqb",
+    .parts = { part1, part2 },
+    .answers = { 346386, 9958218 },
+    .reports = {
+        "Santa's secret number for 5 zeroes is %" PRId64 ".",
+        "Santa's secret number for 6 zeroes is %" PRId64 ".",
+    },
+};
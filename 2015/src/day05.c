@@ -1,9 +1,15 @@
 #include "2015.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#if AOC_X86
+#include <immintrin.h>
+#endif
 
 
 #define ARRAY_SIZE(array) (sizeof(array)/sizeof(*(array)))
@@ -45,9 +51,10 @@ static const uint8_t sbox[] = {
 };
 
 
-static int
-part1(const char *input)
+static int64_t
+count_nice_scalar(const char *input, size_t length)
 {
+    (void)length;
 #define NICE 0x7 // i.e., 0b111
 
     int result = 0;
@@ -108,9 +115,195 @@ part1(const char *input)
 }
 
 
-static int
-part2(const char *input)
+#if AOC_X86
+
+// The input is classified 64 bytes at a time into bitmasks of its vowels,
+// doubled letters, forbidden pairs (marked at their second letter), and
+// newlines. Vowels, and the letters that start forbidden pairs, are looked up
+// by nibble: each nibble table holds the classes its low or high nibble could
+// be part of, and a byte's classes are those both agree on. Doubles and pairs
+// come from comparing each byte with the byte before, which is the previous
+// vector shifted in. Lines can be any length, so they're then picked out of
+// the masks between newlines, and a line that runs on past a block carries on
+// into the next.
+
+#define NICE_BLOCK 64
+
+// Classes: a vowel with a high nibble of 6 or 7, or a pair start ('a', 'c',
+// 'p' or 'x') with a high nibble of 6 or 7.
+#define VOWEL_6 0x01
+#define VOWEL_7 0x02
+#define PAIR_START_6 0x04
+#define PAIR_START_7 0x08
+
+
+// A line's rules, as far as it's been read.
+typedef struct NiceLine
+{
+    uint32_t nvowels;
+    uint64_t doubles;
+    uint64_t forbidden;
+} NiceLine;
+
+
+static bool
+is_nice(const NiceLine *line)
+{
+    bool result = (line->nvowels >= 3) && line->doubles && !line->forbidden;
+    return result;
+}
+
+
+// Counts the nice lines ending in a block, and carries the rest of the block
+// into the line that runs on from it.
+static int64_t
+count_nice_lines(NiceLine *line, uint64_t vowels, uint64_t doubles, uint64_t forbidden, uint64_t newlines)
+{
+    int64_t result = 0;
+    uint64_t rest = UINT64_MAX;
+    while (newlines)
+    {
+        // Everything up to and including the next newline.
+        uint64_t through = newlines ^ (newlines - 1);
+        uint64_t mask = rest & through;
+        line->nvowels += (uint32_t)__builtin_popcountll(vowels & mask);
+        line->doubles |= doubles & mask;
+        line->forbidden |= forbidden & mask;
+
+        result += is_nice(line);
+        *line = (NiceLine){0};
+
+        rest &= ~through;
+        newlines &= newlines - 1;
+    }
+
+    line->nvowels += (uint32_t)__builtin_popcountll(vowels & rest);
+    line->doubles |= doubles & rest;
+    line->forbidden |= forbidden & rest;
+
+    return result;
+}
+
+
+__attribute__((target("avx2")))
+static int64_t
+count_nice_avx2(const char *input, size_t length)
+{
+    const __m256i low_classes = _mm256_setr_epi8(
+        PAIR_START_7, VOWEL_6 | PAIR_START_6, 0, PAIR_START_6, 0, VOWEL_6 | VOWEL_7, 0, 0,
+        PAIR_START_7, VOWEL_6, 0, 0, 0, 0, 0, VOWEL_6,
+        PAIR_START_7, VOWEL_6 | PAIR_START_6, 0, PAIR_START_6, 0, VOWEL_6 | VOWEL_7, 0, 0,
+        PAIR_START_7, VOWEL_6, 0, 0, 0, 0, 0, VOWEL_6);
+    const __m256i high_classes = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, VOWEL_6 | PAIR_START_6, VOWEL_7 | PAIR_START_7,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, VOWEL_6 | PAIR_START_6, VOWEL_7 | PAIR_START_7,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    int64_t result = 0;
+    NiceLine line = {0};
+    __m256i last = zero;
+    uint64_t pair_start_carry = 0;
+
+    char padded[NICE_BLOCK];
+    for (size_t offset = 0; offset < length; offset += NICE_BLOCK)
+    {
+        // The last block is padded out with zeroes, which aren't anything.
+        const char *block = input + offset;
+        size_t remaining = length - offset;
+        uint64_t valid = UINT64_MAX;
+        if (remaining < NICE_BLOCK)
+        {
+            memset(padded, 0, sizeof(padded));
+            memcpy(padded, block, remaining);
+            block = padded;
+            valid = (1ull << remaining) - 1;
+        }
+
+        uint64_t vowels = 0;
+        uint64_t doubles = 0;
+        uint64_t successors = 0;
+        uint64_t pair_starts = 0;
+        uint64_t newlines = 0;
+        for (uint32_t i = 0; i < NICE_BLOCK; i += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256((const __m256i *)(const void *)(block + i));
+            __m256i before = _mm256_alignr_epi8(chunk, _mm256_permute2x128_si256(last, chunk, 0x21), 15);
+            last = chunk;
+
+            __m256i low = _mm256_shuffle_epi8(low_classes, _mm256_and_si256(chunk, nibble));
+            __m256i high = _mm256_shuffle_epi8(high_classes, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble));
+            __m256i classes = _mm256_and_si256(low, high);
+
+            __m256i is_vowel = _mm256_cmpeq_epi8(_mm256_and_si256(classes, _mm256_set1_epi8(VOWEL_6 | VOWEL_7)), zero);
+            __m256i is_pair_start = _mm256_cmpeq_epi8(_mm256_and_si256(classes, _mm256_set1_epi8(PAIR_START_6 | PAIR_START_7)), zero);
+            __m256i is_double = _mm256_cmpeq_epi8(chunk, before);
+            __m256i is_successor = _mm256_cmpeq_epi8(chunk, _mm256_add_epi8(before, _mm256_set1_epi8(1)));
+            __m256i is_newline = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+
+            // The class compares are against zero, so are inverted.
+            vowels |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(is_vowel) << i;
+            pair_starts |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(is_pair_start) << i;
+            doubles |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_double) << i;
+            successors |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_successor) << i;
+            newlines |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_newline) << i;
+        }
+
+        // A pair is forbidden if it starts with a pair start, one letter
+        // before the letter following it.
+        uint64_t forbidden = successors & ((pair_starts << 1) | pair_start_carry);
+        pair_start_carry = pair_starts >> 63;
+
+        // Blank lines double their newlines, which mustn't count.
+        doubles &= ~newlines;
+
+        result += count_nice_lines(&line, vowels & valid, doubles & valid, forbidden & valid, newlines & valid);
+    }
+
+    // A last line without a newline still counts.
+    result += is_nice(&line);
+
+    return result;
+}
+
+#endif // AOC_X86
+
+
+typedef int64_t CountNice(const char *input, size_t length);
+
+
+static CountNice *
+select_nice_kernel(void)
 {
+    CountNice *result = count_nice_scalar;
+
+#if AOC_X86
+    __builtin_cpu_init();
+    if (!force_scalar && __builtin_cpu_supports("avx2"))
+    {
+        result = count_nice_avx2;
+    }
+#endif
+
+    return result;
+}
+
+
+static int64_t
+part1(const char *input, size_t length)
+{
+    CountNice *count_nice = select_nice_kernel();
+    int64_t result = count_nice(input, length);
+    return result;
+}
+
+
+static int64_t
+part2(const char *input, size_t length)
+{
+    (void)length;
 #define NICE 0x3 // i.e, 0b11
 
     typedef struct Pair
@@ -180,16 +373,13 @@ part2(const char *input)
 }
 
 
-void
-day05(const char *input)
-{
-    puts("\nDay 05:");
-
-    int result = part1(input);
-    assert(result == 258);
-    printf("%d strings are nice.\n", result);
-
-    result = part2(input);
-    assert(result == 53);
-    printf("%d new strings are nice.\n", result);
-}
+const Day day05 = {
+    .name = "Day 05",
+    .filename = "day05.txt",
+    .parts = { part1, part2 },
+    .answers = { 258, 53 },
+    .reports = {
+        "%" PRId64 " strings are nice.",
+        "%" PRId64 " new strings are nice.",
+    },
+};
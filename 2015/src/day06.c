@@ -2,11 +2,13 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 #define GRID_DIMENSION 1000
@@ -139,9 +141,10 @@ parse_instruction(const char **input, Instruction *instruction)
 }
 
 
-static int
-part1(const char *input)
+static int64_t
+part1(const char *input, size_t length)
 {
+    (void)length;
     char *grid = calloc(GRID_DIMENSION * GRID_DIMENSION, sizeof(*grid));
     assert(grid);
 
@@ -195,9 +198,10 @@ part1(const char *input)
 }
 
 
-static int
-part2(const char *input)
+static int64_t
+part2(const char *input, size_t length)
 {
+    (void)length;
     char *grid = calloc(GRID_DIMENSION * GRID_DIMENSION, sizeof(*grid));
 
     while (*input)
@@ -252,26 +256,16 @@ part2(const char *input)
 }
 
 
-void
-day06(const char *input)
-{
-    puts("\nDay 06:");
-
-    int result = part1(input);
-    assert(result == 543903);
-    printf("%u lights are lit.\n", result);
-
-    result = part2(input);
-    assert(result == 14687245);
-    printf("Total brightness is %u.\n", result);
-
 #if 0
+static void
+test_day06(void)
+{
 #define ARRAY_SIZE(array) (sizeof(array)/sizeof(*(array)))
 
     typedef struct Test
     {
         const char *input;
-        uint32_t expected;
+        int64_t expected;
     } Test;
 
 
@@ -293,9 +287,20 @@ day06(const char *input)
     for (unsigned i = 0; i < ARRAY_SIZE(tests); ++i)
     {
         Test *test = tests + i;
-        uint32_t actual = parse_instructions(test->input);
+        int64_t actual = part1(test->input, strlen(test->input));
         assert(actual == test->expected);
     }
+}
 #endif
 
-}
+
+const Day day06 = {
+    .name = "Day 06",
+    .filename = "day06.txt",
+    .parts = { part1, part2 },
+    .answers = { 543903, 14687245 },
+    .reports = {
+        "%" PRId64 " lights are lit.",
+        "Total brightness is %" PRId64 ".",
+    },
+};
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -473,33 +474,65 @@ parse_instructions(const char *input, Circuit *circuit)
 }
 
 
-void
-day07(const char *input)
+static uint16_t
+signal_on_a(Circuit *circuit)
 {
-    puts("\nDay 07:");
+    Wire wire = { .value = 'a' };
+    uint16_t result = lookup_signal(circuit, wire);
+    return result;
+}
+
 
+static int64_t
+part1(const char *input, size_t length)
+{
+    (void)length;
 
     Circuit circuit;
     init_circuit(&circuit);
 
     parse_instructions(input, &circuit);
+    uint16_t result = signal_on_a(&circuit);
+
+    delete_circuit(&circuit);
+    return result;
+}
 
-    Wire wire = { .value = 'a' };
-    uint16_t result = lookup_signal(&circuit, wire);
-    assert(result == 46065);
-    printf("Circuit 'a' has signal: %u\n", result);
+
+static int64_t
+part2(const char *input, size_t length)
+{
+    (void)length;
+
+    Circuit circuit;
+    init_circuit(&circuit);
 
     parse_instructions(input, &circuit);
+    uint16_t result = signal_on_a(&circuit);
 
-    wire.value = 'b';
+    // Looking up signals overwrites the circuit with their values, so parse it
+    // again to reset it.
+    parse_instructions(input, &circuit);
+
+    Wire wire = { .value = 'b' };
     Connection *connection = find_connection(&circuit, wire);
     connection->type = TOKEN_VALUE;
     connection->source.value = result;
 
-    wire.value = 'a';
-    result = lookup_signal(&circuit, wire);
-    assert(result == 14134);
-    printf("After overriding circuit 'b', circuit 'a' has signal: %u\n", result);
+    result = signal_on_a(&circuit);
 
     delete_circuit(&circuit);
+    return result;
 }
+
+
+const Day day07 = {
+    .name = "Day 07",
+    .filename = "day07.txt",
+    .parts = { part1, part2 },
+    .answers = { 46065, 14134 },
+    .reports = {
+        "Circuit 'a' has signal: %" PRId64,
+        "After overriding circuit 'b', circuit 'a' has signal: %" PRId64,
+    },
+};
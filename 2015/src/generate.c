@@ -0,0 +1,521 @@
+// Generates large, valid puzzle inputs for scaling benchmarks.
+//
+// usage: generate [-s seed] [-o output] [-a answers] day bytes
+//
+// Writes about `bytes` bytes of input for the day to output (default stdout).
+// The same seed always gives the same input. With -a, also solves the input
+// with the scalar solvers on one thread and writes their answers to the
+// answers file, one per line, to check faster solvers against.
+//
+// For day 04, `bytes` is the length of the secret key. Day 07's wires have at
+// most two-letter names, so its circuits stop growing at 702 wires.
+
+#include "2015.h"
+
+// stdlib
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define ARRAY_SIZE(array) (sizeof(array)/sizeof(*(array)))
+
+#define FLUSH_SIZE (1 << 20)
+#define MAX_LINE_LENGTH 64
+#define MAX_WIRES (26 + (26 * 26))
+
+
+typedef struct Output
+{
+    FILE *fh;
+    // Holds everything written so far if kept for solving afterwards, or else
+    // just what's waiting to be flushed.
+    char *data;
+    size_t size;
+    size_t capacity;
+    size_t written;
+    bool keep;
+} Output;
+
+
+typedef struct Random
+{
+    uint64_t state;
+} Random;
+
+
+static const Day *const days[] = {
+    &day01,
+    &day02,
+    &day03,
+    &day04,
+    &day05,
+    &day06,
+    &day07,
+};
+
+
+// splitmix64
+static uint64_t
+next_random(Random *random)
+{
+    random->state += 0x9e3779b97f4a7c15;
+
+    uint64_t result = random->state;
+    result = (result ^ (result >> 30)) * 0xbf58476d1ce4e5b9;
+    result = (result ^ (result >> 27)) * 0x94d049bb133111eb;
+    result = result ^ (result >> 31);
+    return result;
+}
+
+
+// Uniform in [0, bound), near enough for bounds this small.
+static uint32_t
+random_below(Random *random, uint32_t bound)
+{
+    uint32_t result = (uint32_t)(((next_random(random) >> 32) * bound) >> 32);
+    return result;
+}
+
+
+static void
+flush_output(Output *output)
+{
+    if (!output->keep)
+    {
+        size_t written = fwrite(output->data, 1, output->size, output->fh);
+        assert(written == output->size);
+        (void)written;
+
+        output->size = 0;
+    }
+}
+
+
+// Returns room for at least MAX_LINE_LENGTH more bytes.
+static char *
+reserve_line(Output *output)
+{
+    if (output->capacity - output->size < MAX_LINE_LENGTH + 1)
+    {
+        output->capacity *= 2;
+        output->data = realloc(output->data, output->capacity);
+        assert(output->data);
+    }
+
+    char *result = output->data + output->size;
+    return result;
+}
+
+
+static void
+commit_line(Output *output, size_t length)
+{
+    assert(length <= MAX_LINE_LENGTH);
+    output->size += length;
+    output->written += length;
+
+    if (output->size >= FLUSH_SIZE)
+    {
+        flush_output(output);
+    }
+}
+
+
+static void
+write_line(Output *output, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+
+static void
+write_line(Output *output, const char *format, ...)
+{
+    char *line = reserve_line(output);
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, MAX_LINE_LENGTH + 1, format, args);
+    va_end(args);
+
+    assert((length >= 0) && (length <= MAX_LINE_LENGTH));
+    commit_line(output, (size_t)length);
+}
+
+
+//
+// Generators
+//
+
+// Parentheses, 64 at a time. Santa climbs for a random quarter to three
+// quarters of the input, three steps in four going up after a first line of
+// nothing else, and then descends just as steeply. So he either reaches the
+// basement late, after about twice the climb, or never does.
+static void
+generate_day01(Output *output, Random *random, size_t bytes)
+{
+    size_t climb = (bytes / 4) + (((bytes / 2) / 1024) * random_below(random, 1024));
+    while (output->written < bytes)
+    {
+        char *line = reserve_line(output);
+        uint64_t a = next_random(random);
+        uint64_t b = next_random(random);
+        uint64_t bits = (output->written < climb) ? (a & b) : (a | b);
+        if (output->written == 0)
+        {
+            bits = 0;
+        }
+        for (size_t i = 0; i < 64; ++i)
+        {
+            line[i] = "()"[(bits >> i) & 1];
+        }
+        commit_line(output, 64);
+    }
+
+    write_line(output, "\n");
+}
+
+
+// Boxes up to 30 on a side, like the puzzle's.
+static void
+generate_day02(Output *output, Random *random, size_t bytes)
+{
+    while (output->written < bytes)
+    {
+        write_line(output, "%ux%ux%u\n",
+                   1 + random_below(random, 30),
+                   1 + random_below(random, 30),
+                   1 + random_below(random, 30));
+    }
+}
+
+
+// Moves, 32 at a time.
+static void
+generate_day03(Output *output, Random *random, size_t bytes)
+{
+    while (output->written < bytes)
+    {
+        char *line = reserve_line(output);
+        uint64_t bits = next_random(random);
+        for (size_t i = 0; i < 32; ++i)
+        {
+            line[i] = "^v<>"[(bits >> (2 * i)) & 3];
+        }
+        commit_line(output, 32);
+    }
+
+    write_line(output, "\n");
+}
+
+
+// A secret key of `bytes` letters.
+static void
+generate_day04(Output *output, Random *random, size_t bytes)
+{
+    assert(bytes > 0);
+    while (output->written < bytes)
+    {
+        size_t length = bytes - output->written;
+        if (length > MAX_LINE_LENGTH)
+        {
+            length = MAX_LINE_LENGTH;
+        }
+
+        char *line = reserve_line(output);
+        for (size_t i = 0; i < length; ++i)
+        {
+            line[i] = (char)('a' + random_below(random, 26));
+        }
+        commit_line(output, length);
+    }
+
+    write_line(output, "\n");
+}
+
+
+// 16-letter strings, like the puzzle's. Day 05's pair table is sized for them.
+static void
+generate_day05(Output *output, Random *random, size_t bytes)
+{
+    while (output->written < bytes)
+    {
+        char *line = reserve_line(output);
+        for (size_t i = 0; i < 16; ++i)
+        {
+            line[i] = (char)('a' + random_below(random, 26));
+        }
+        line[16] = '\n';
+        commit_line(output, 17);
+    }
+}
+
+
+// Instructions over the whole 1000x1000 grid. Turning lights off is the most
+// common, so brightness drifts down and stays within day 06's 8-bit cells.
+static void
+generate_day06(Output *output, Random *random, size_t bytes)
+{
+    while (output->written < bytes)
+    {
+        uint32_t x[2] = { random_below(random, 1000), random_below(random, 1000) };
+        uint32_t y[2] = { random_below(random, 1000), random_below(random, 1000) };
+        uint32_t from_x = (x[0] < x[1]) ? x[0] : x[1];
+        uint32_t from_y = (y[0] < y[1]) ? y[0] : y[1];
+        uint32_t to_x = x[0] ^ x[1] ^ from_x;
+        uint32_t to_y = y[0] ^ y[1] ^ from_y;
+
+        uint32_t roll = random_below(random, 10);
+        const char *operation = (roll < 2) ? "turn on" : (roll < 3) ? "toggle" : "turn off";
+
+        write_line(output, "%s %u,%u through %u,%u\n", operation, from_x, from_y, to_x, to_y);
+    }
+}
+
+
+// The name of the wire at a position in the circuit's evaluation order: "b",
+// then the wires from "c" to "zz", with "a" last.
+static void
+wire_name(uint32_t position, uint32_t nwires, char *name)
+{
+    uint32_t index = (position == 0) ? 1 : (position == nwires - 1) ? 0 : position + 1;
+    if (index < 26)
+    {
+        name[0] = (char)('a' + index);
+        name[1] = 0;
+    }
+    else
+    {
+        name[0] = (char)('a' + ((index - 26) / 26));
+        name[1] = (char)('a' + ((index - 26) % 26));
+        name[2] = 0;
+    }
+}
+
+
+// An acyclic circuit: each wire only reads wires earlier in the evaluation
+// order, and the lines are shuffled so the solver has to find its way. Shifts
+// are kept short, or the signals soon shift out to all zeroes.
+//
+// "b" is the only wire given a signal directly, below 0x8000, and the last
+// three wires make "a" NOT (b OR (x RSHIFT n)) for some earlier wire x. So "a"
+// always has its top bit set, and once it overrides "b", never does, and the
+// two parts' answers differ.
+static void
+generate_day07(Output *output, Random *random, size_t bytes)
+{
+    uint32_t nwires = (uint32_t)((bytes / 16) < MAX_WIRES ? (bytes / 16) : MAX_WIRES);
+    if (nwires < 8)
+    {
+        nwires = 8;
+    }
+
+    uint32_t order[MAX_WIRES];
+    for (uint32_t i = 0; i < nwires; ++i)
+    {
+        order[i] = i;
+    }
+    for (uint32_t i = nwires - 1; i > 0; --i)
+    {
+        uint32_t j = random_below(random, i + 1);
+        uint32_t swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    for (uint32_t i = 0; i < nwires; ++i)
+    {
+        uint32_t position = order[i];
+
+        char wire[3];
+        char left[3];
+        char right[8];
+        wire_name(position, nwires, wire);
+        wire_name(random_below(random, position ? position : 1), nwires, left);
+        if (random_below(random, 4))
+        {
+            wire_name(random_below(random, position ? position : 1), nwires, right);
+        }
+        else
+        {
+            snprintf(right, sizeof(right), "%u", random_below(random, 60000));
+        }
+
+        uint32_t gate = (position == 0) ? 0 : 1 + random_below(random, 6);
+        if (position >= (nwires - 3))
+        {
+            gate = 7 + (position - (nwires - 3));
+        }
+
+        char previous[3];
+        if (position > 0)
+        {
+            wire_name(position - 1, nwires, previous);
+        }
+
+        switch (gate)
+        {
+            case 0:
+                write_line(output, "%u -> %s\n", random_below(random, 0x8000), wire);
+                break;
+
+            case 1:
+                write_line(output, "%s -> %s\n", left, wire);
+                break;
+
+            case 2:
+                write_line(output, "NOT %s -> %s\n", left, wire);
+                break;
+
+            case 3:
+                write_line(output, "%s AND %s -> %s\n", left, right, wire);
+                break;
+
+            case 4:
+                write_line(output, "%s OR %s -> %s\n", left, right, wire);
+                break;
+
+            case 5:
+                write_line(output, "%s LSHIFT %u -> %s\n", left, 1 + random_below(random, 3), wire);
+                break;
+
+            // the last three wires, ending with "a", start with x
+            case 6:
+            case 7:
+                write_line(output, "%s RSHIFT %u -> %s\n", left, 1 + random_below(random, 3), wire);
+                break;
+
+            case 8:
+                write_line(output, "b OR %s -> %s\n", previous, wire);
+                break;
+
+            case 9:
+                write_line(output, "NOT %s -> %s\n", previous, wire);
+                break;
+        }
+    }
+}
+
+
+typedef void Generator(Output *output, Random *random, size_t bytes);
+
+static Generator *const generators[] = {
+    generate_day01,
+    generate_day02,
+    generate_day03,
+    generate_day04,
+    generate_day05,
+    generate_day06,
+    generate_day07,
+};
+
+
+static void
+write_answers(const char *filename, const Day *day, const char *input, size_t length)
+{
+    FILE *fh = fopen(filename, "w");
+    if (!fh)
+    {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+
+    force_scalar = true;
+    for (size_t part = 0; part < 2; ++part)
+    {
+        fprintf(fh, "%" PRId64 "\n", day->parts[part](input, length));
+    }
+
+    fclose(fh);
+}
+
+
+static void
+usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-s seed] [-o output] [-a answers] day bytes\n", program);
+    exit(EXIT_FAILURE);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    uint64_t seed = 1;
+    const char *output_filename = 0;
+    const char *answers_filename = 0;
+
+    int arg = 1;
+    for (; (arg + 1 < argc) && (argv[arg][0] == '-'); arg += 2)
+    {
+        if (strcmp(argv[arg], "-s") == 0)
+        {
+            seed = strtoull(argv[arg + 1], 0, 10);
+        }
+        else if (strcmp(argv[arg], "-o") == 0)
+        {
+            output_filename = argv[arg + 1];
+        }
+        else if (strcmp(argv[arg], "-a") == 0)
+        {
+            answers_filename = argv[arg + 1];
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+
+    if (argc - arg != 2)
+    {
+        usage(argv[0]);
+    }
+
+    unsigned long day = strtoul(argv[arg], 0, 10);
+    unsigned long long bytes = strtoull(argv[arg + 1], 0, 10);
+    if ((day < 1) || (day > ARRAY_SIZE(days)) || (bytes == 0))
+    {
+        usage(argv[0]);
+    }
+
+    Output output = {
+        .fh = output_filename ? fopen(output_filename, "wb") : stdout,
+        .capacity = FLUSH_SIZE + MAX_LINE_LENGTH + 1,
+        .keep = answers_filename != 0,
+    };
+    if (!output.fh)
+    {
+        perror(output_filename);
+        return EXIT_FAILURE;
+    }
+
+    output.data = malloc(output.capacity);
+    assert(output.data);
+
+    // Mix in the day so each day's input differs for the same seed.
+    Random random = { seed ^ (day << 56) };
+    generators[day - 1](&output, &random, (size_t)bytes);
+
+    output.keep = false;
+    size_t length = output.size;
+    flush_output(&output);
+    fflush(output.fh);
+
+    if (answers_filename)
+    {
+        // The solvers expect a terminator after the input.
+        output.data[length] = 0;
+        write_answers(answers_filename, days[day - 1], output.data, length);
+    }
+
+    int result = ferror(output.fh) ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (output_filename)
+    {
+        fclose(output.fh);
+    }
+    free(output.data);
+
+    return result;
+}
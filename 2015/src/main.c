@@ -1,73 +1,829 @@
+// MAP_ANONYMOUS and madvise
+#define _DEFAULT_SOURCE
+
 #include "2015.h"
+#include "parallel.h"
+#include "perf.h"
 
 // posix
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 // stdlib
 #include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+
+#define ARRAY_SIZE(array) (sizeof(array)/sizeof(*(array)))
 
 
-typedef struct Buffer
+// A read-only view of a puzzle input. The byte after the input is always 0, so
+// solvers may either use the length or scan for the terminator.
+typedef struct Input
 {
+    const char *data;
     size_t size;
-    size_t capacity;
-    char *data;
-} Buffer;
 
-static Buffer buffer;
+    // Either the whole mapping backing a mapped file, or the heap buffer
+    // holding a file that couldn't be mapped.
+    void *mapping;
+    size_t mapping_size;
+    char *buffer;
+} Input;
+
+
+static bool
+map_file(int fd, size_t size, Input *input)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapping_size = (size + page_size) & ~(page_size - 1);
+
+    // Reserve room for the file plus at least one byte with anonymous (zeroed)
+    // pages, then map the file over the front of it. The rest of the file's
+    // last page reads as zeroes, and if the file ends exactly on a page
+    // boundary the reserved page after it provides the terminator.
+    char *mapping = mmap(0, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    if (size)
+    {
+        void *file = mmap(mapping, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (file == MAP_FAILED)
+        {
+            munmap(mapping, mapping_size);
+            return false;
+        }
+
+        madvise(mapping, size, MADV_SEQUENTIAL);
+    }
+
+    input->data = mapping;
+    input->size = size;
+    input->mapping = mapping;
+    input->mapping_size = mapping_size;
+    input->buffer = 0;
+
+    return true;
+}
+
+
+// Reports an input that can't be read, and exits.
+static void
+input_error(const char *name, const char *message)
+{
+    if (message)
+    {
+        fprintf(stderr, "%s: %s\n", name, message);
+    }
+    else
+    {
+        perror(name);
+    }
+
+    exit(EXIT_FAILURE);
+}
+
+
+static void
+read_stream(FILE *fh, const char *name, Input *input)
+{
+    size_t size = 0;
+    size_t capacity = 1 << 16;
+    char *buffer = malloc(capacity);
+    assert(buffer);
+
+    size_t bytes_read;
+    while ((bytes_read = fread(buffer + size, 1, capacity - size - 1, fh)) > 0)
+    {
+        size += bytes_read;
+        if ((capacity - size) == 1)
+        {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            assert(buffer);
+        }
+    }
+    if (ferror(fh))
+    {
+        input_error(name, 0);
+    }
+    buffer[size] = 0;
+
+    input->data = buffer;
+    input->size = size;
+    input->mapping = 0;
+    input->mapping_size = 0;
+    input->buffer = buffer;
+}
 
 
-static Buffer *
-read_file(const char *filename)
+static void
+read_file(const char *filename, Input *input)
 {
+    FILE *fh = fopen(filename, "rb");
+    if (!fh)
+    {
+        input_error(filename, 0);
+    }
+
     struct stat fileinfo;
-    int status = stat(filename, &fileinfo);
+    if (fstat(fileno(fh), &fileinfo) != 0)
+    {
+        input_error(filename, 0);
+    }
+
+    // Pipes, devices and the like can't be mapped, so those are read into a
+    // buffer instead.
+    if (!S_ISREG(fileinfo.st_mode) || !map_file(fileno(fh), (size_t)fileinfo.st_size, input))
+    {
+        read_stream(fh, filename, input);
+    }
+
+    fclose(fh);
+}
+
+
+static void
+release_input(Input *input)
+{
+    if (input->mapping)
+    {
+        munmap(input->mapping, input->mapping_size);
+    }
+    free(input->buffer);
+
+    input->data = 0;
+    input->size = 0;
+}
+
+
+// Loads a day's input from path if given ("-" being stdin), or else from its
+// usual file in datadir, or its builtin input.
+static void
+load_input(const Day *day, const char *path, const char *datadir, Input *input)
+{
+    char joined[4096];
+    if (!path && day->filename)
+    {
+        int length = snprintf(joined, sizeof(joined), "%s/%s", datadir, day->filename);
+        if ((length < 0) || ((size_t)length >= sizeof(joined)))
+        {
+            input_error(datadir, "path too long");
+        }
+
+        path = joined;
+    }
+
+    if (!path)
+    {
+        input->data = day->builtin_input;
+        input->size = strlen(day->builtin_input);
+        input->mapping = 0;
+        input->mapping_size = 0;
+        input->buffer = 0;
+        return;
+    }
+
+    const char *name = path;
+    if (strcmp(path, "-") == 0)
+    {
+        name = "stdin";
+        read_stream(stdin, name, input);
+    }
+    else
+    {
+        read_file(path, input);
+    }
+
+    if (input->size == 0)
+    {
+        input_error(name, "empty input");
+    }
+}
+
+
+//
+// Scheduling
+//
+// Every part of every day is an independent job, except that days which can
+// solve both parts at once do so in one job. Jobs are handed out to a pool of
+// workers in order through an atomic counter, and each job's answers go in
+// their own slots, so the report can be printed in order once they're all done.
+//
+
+static const Day *const days[] = {
+    &day01,
+    &day02,
+    &day03,
+    &day04,
+    &day05,
+    &day06,
+    &day07,
+};
+
+#define NDAYS ARRAY_SIZE(days)
+#define NJOBS (2 * NDAYS)
+
+// a Job's part when it solves both at once
+#define BOTH_PARTS 2
+
+
+typedef struct Job
+{
+    uint8_t day;
+    uint8_t part;
+} Job;
+
+
+typedef struct Schedule
+{
+    Input inputs[NDAYS];
+    bool selected[NDAYS][2];
+    // The known answers only hold for the usual inputs.
+    bool check[NDAYS];
+    int64_t answers[NDAYS][2];
+
+    Job jobs[NJOBS];
+    unsigned njobs;
+    atomic_uint next_job;
+} Schedule;
+
+
+static void
+run_job(const Job *job, const Input *input, int64_t answers[2])
+{
+    const Day *day = days[job->day];
+    if (job->part == BOTH_PARTS)
+    {
+        day->solve(input->data, input->size, answers);
+    }
+    else
+    {
+        answers[job->part] = day->parts[job->part](input->data, input->size);
+    }
+}
+
+
+static void
+run_jobs(void *data, uint32_t worker)
+{
+    (void)worker;
+    Schedule *schedule = data;
+
+    for (unsigned next = atomic_fetch_add(&schedule->next_job, 1);
+         next < schedule->njobs;
+         next = atomic_fetch_add(&schedule->next_job, 1))
+    {
+        const Job *job = schedule->jobs + next;
+        run_job(job, schedule->inputs + job->day, schedule->answers[job->day]);
+    }
+}
+
+
+static bool
+is_day_selected(const Schedule *schedule, size_t day)
+{
+    bool result = schedule->selected[day][0] || schedule->selected[day][1];
+    return result;
+}
+
+
+static void
+print_day_header(const Day *day, bool *first)
+{
+    printf("%s%s:\n", *first ? "" : "\n", day->name);
+    *first = false;
+}
+
+
+static void
+print_answer(const Schedule *schedule, size_t day, size_t part, int64_t answer)
+{
+    assert(!schedule->check[day] || (answer == days[day]->answers[part]));
+    printf(days[day]->reports[part], answer);
+    putchar('\n');
+}
+
+
+static void
+solve(Schedule *schedule, size_t repeat)
+{
+    schedule->njobs = 0;
+    for (uint8_t day = 0; day < NDAYS; ++day)
+    {
+        const bool *selected = schedule->selected[day];
+        if (selected[0] && selected[1] && days[day]->solve)
+        {
+            schedule->jobs[schedule->njobs++] = (Job){ day, BOTH_PARTS };
+            continue;
+        }
+
+        for (uint8_t part = 0; part < 2; ++part)
+        {
+            if (selected[part])
+            {
+                schedule->jobs[schedule->njobs++] = (Job){ day, part };
+            }
+        }
+    }
+
+    uint32_t nworkers = processor_count();
+    if (nworkers > schedule->njobs)
+    {
+        nworkers = schedule->njobs;
+    }
+
+    for (size_t i = 0; i < repeat; ++i)
+    {
+        atomic_init(&schedule->next_job, 0);
+        run_parallel(run_jobs, schedule, nworkers);
+    }
+
+    bool first = true;
+    for (size_t i = 0; i < NDAYS; ++i)
+    {
+        if (!is_day_selected(schedule, i))
+        {
+            continue;
+        }
+
+        print_day_header(days[i], &first);
+        for (size_t part = 0; part < 2; ++part)
+        {
+            if (schedule->selected[i][part])
+            {
+                print_answer(schedule, i, part, schedule->answers[i][part]);
+            }
+        }
+    }
+}
+
+
+//
+// Benchmarking
+//
+// Runs each part on its own, one after another so they don't compete for the
+// machine, timing every call with the monotonic clock once the inputs are
+// loaded. The statistics are printed as JSON so runs can be compared between
+// commits.
+//
+
+#define DEFAULT_ITERATIONS 25
+#define DEFAULT_WARMUP 3
+
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec time;
+    int status = clock_gettime(CLOCK_MONOTONIC, &time);
     assert(status == 0);
-    assert(S_ISREG(fileinfo.st_mode) && (fileinfo.st_size > 0));
 
-    FILE *fh = fopen(filename, "r");
-    assert(fh);
+    uint64_t result = ((uint64_t)time.tv_sec * 1000000000) + (uint64_t)time.tv_nsec;
+    return result;
+}
+
+
+static int
+compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    int result = (x > y) - (x < y);
+    return result;
+}
+
 
-    buffer.size = (size_t)fileinfo.st_size;
-    if (buffer.capacity < buffer.size)
+// Nearest-rank percentile of sorted samples.
+static uint64_t
+percentile(const uint64_t *samples, size_t count, unsigned percent)
+{
+    size_t rank = ((count * percent) + 99) / 100;
+    if (rank == 0)
     {
-        buffer.data = realloc(buffer.data, buffer.size + 1);
-        assert(buffer.data);
-        buffer.capacity = buffer.size;
+        rank = 1;
     }
 
-    size_t bytes_read = fread(buffer.data, 1, buffer.size, fh);
-    assert(bytes_read == buffer.size);
-    buffer.data[buffer.size] = 0;
+    uint64_t result = samples[rank - 1];
+    return result;
+}
+
 
-    fclose(fh);
+static void
+check_job(const Schedule *schedule, const Job *job, const int64_t answers[2])
+{
+    if (schedule->check[job->day])
+    {
+        const Day *day = days[job->day];
+        for (size_t part = 0; part < 2; ++part)
+        {
+            bool ran = (job->part == BOTH_PARTS) || (job->part == part);
+            assert(!ran || (answers[part] == day->answers[part]));
+            (void)day;
+            (void)ran;
+        }
+    }
+}
+
+
+static void
+time_job(const Schedule *schedule, const Job *job, uint64_t *samples, size_t iterations, size_t warmup)
+{
+    const Input *input = schedule->inputs + job->day;
+    int64_t answers[2];
+
+    for (size_t j = 0; j < warmup; ++j)
+    {
+        run_job(job, input, answers);
+        check_job(schedule, job, answers);
+    }
+
+    for (size_t j = 0; j < iterations; ++j)
+    {
+        uint64_t start = now_ns();
+        run_job(job, input, answers);
+        samples[j] = now_ns() - start;
+
+        check_job(schedule, job, answers);
+    }
+
+    qsort(samples, iterations, sizeof(*samples), compare_u64);
+}
+
+
+// Times each selected part, and days that can solve both parts at once doing
+// so, as "part": "both".
+static void
+benchmark(const Schedule *schedule, size_t iterations, size_t warmup)
+{
+    uint64_t *samples = malloc(iterations * sizeof(*samples));
+    assert(samples);
+
+    printf("{\n  \"iterations\": %zu,\n  \"warmup\": %zu,\n  \"results\": [", iterations, warmup);
 
-    return &buffer;
+    bool first = true;
+    for (uint8_t i = 0; i < NDAYS; ++i)
+    {
+        const Day *day = days[i];
+        const bool *selected = schedule->selected[i];
+
+        for (uint8_t part = 0; part <= BOTH_PARTS; ++part)
+        {
+            bool wanted = (part == BOTH_PARTS) ? (selected[0] && selected[1] && day->solve) : selected[part];
+            if (!wanted)
+            {
+                continue;
+            }
+
+            Job job = { i, part };
+            time_job(schedule, &job, samples, iterations, warmup);
+
+            const char *name = (part == BOTH_PARTS) ? "\"both\"" : (part == 0) ? "1" : "2";
+
+            printf("%s\n    { \"day\": \"%s\", \"part\": %s, \"bytes\": %zu, "
+                   "\"min_ns\": %" PRIu64 ", \"median_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 " }",
+                   first ? "" : ",", day->name, name, schedule->inputs[i].size,
+                   samples[0], percentile(samples, iterations, 50), percentile(samples, iterations, 99));
+            first = false;
+        }
+    }
+
+    printf("\n  ]\n}\n");
+    free(samples);
 }
 
 
+//
+// Counters
+//
+// Runs each part once, one after another, under the hardware performance
+// counters and prints what they saw beneath each answer.
+//
+
+static void
+print_event(const PerfSample *sample, PerfEvent event, size_t bytes)
+{
+    const char *name = perf_event_names[event];
+    if (!sample->available[event])
+    {
+        printf("%s n/a", name);
+    }
+    else if (bytes)
+    {
+        printf("%" PRIu64 " %s (%.3f/byte)", sample->values[event], name,
+               (double)sample->values[event] / (double)bytes);
+    }
+    else
+    {
+        printf("%" PRIu64 " %s", sample->values[event], name);
+    }
+}
+
+
+static void
+print_counters(const PerfSample *sample, size_t bytes)
+{
+    printf("    ");
+    print_event(sample, PERF_CYCLES, 0);
+    printf(", ");
+    print_event(sample, PERF_INSTRUCTIONS, 0);
+    if (sample->available[PERF_CYCLES] && sample->available[PERF_INSTRUCTIONS] && sample->values[PERF_CYCLES])
+    {
+        printf(", %.2f IPC", (double)sample->values[PERF_INSTRUCTIONS] / (double)sample->values[PERF_CYCLES]);
+    }
+
+    printf("\n    ");
+    print_event(sample, PERF_BRANCH_MISSES, bytes);
+    printf(", ");
+    print_event(sample, PERF_L1D_MISSES, bytes);
+    printf(", ");
+    print_event(sample, PERF_LLC_MISSES, bytes);
+    putchar('\n');
+}
+
+
+// Each part gets its own counters, since resetting them doesn't clear the
+// counts folded in from worker threads that have exited.
+static void
+count_events(const Schedule *schedule)
+{
+    bool warned = false;
+    bool first = true;
+    for (size_t i = 0; i < NDAYS; ++i)
+    {
+        if (!is_day_selected(schedule, i))
+        {
+            continue;
+        }
+
+        const Input *input = schedule->inputs + i;
+        print_day_header(days[i], &first);
+
+        for (size_t part = 0; part < 2; ++part)
+        {
+            if (!schedule->selected[i][part])
+            {
+                continue;
+            }
+
+            PerfCounters counters;
+            if (!perf_open(&counters) && !warned)
+            {
+                fprintf(stderr, "warning: no hardware performance counters are available\n");
+                warned = true;
+            }
+
+            PerfSample sample;
+            perf_start(&counters);
+            int64_t answer = days[i]->parts[part](input->data, input->size);
+            perf_stop(&counters, &sample);
+            perf_close(&counters);
+
+            print_answer(schedule, i, part, answer);
+            print_counters(&sample, input->size);
+        }
+    }
+}
+
+
+//
+// Command line
+//
+
+static size_t
+parse_count(const char *text)
+{
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    size_t result = ((*text >= '0') && (*text <= '9') && !*end) ? (size_t)value : SIZE_MAX;
+    return result;
+}
+
+
+// Parses a day number at the start of text, returning its index in days or
+// SIZE_MAX, and leaves *end just past it.
+static size_t
+parse_day(const char *text, const char **end)
+{
+    size_t result = SIZE_MAX;
+    *end = text;
+
+    if ((*text >= '0') && (*text <= '9'))
+    {
+        char *after;
+        unsigned long day = strtoul(text, &after, 10);
+        if ((day >= 1) && (day <= NDAYS))
+        {
+            result = day - 1;
+        }
+        *end = after;
+    }
+
+    return result;
+}
+
+
+// day or day.part
+static bool
+parse_selection(const char *text, bool selected[NDAYS][2])
+{
+    const char *end;
+    size_t day = parse_day(text, &end);
+
+    bool result = true;
+    if ((day != SIZE_MAX) && !*end)
+    {
+        selected[day][0] = true;
+        selected[day][1] = true;
+    }
+    else if ((day != SIZE_MAX) && (end[0] == '.') && ((end[1] == '1') || (end[1] == '2')) && !end[2])
+    {
+        selected[day][end[1] - '1'] = true;
+    }
+    else
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+
+// day=path
+static bool
+parse_override(const char *text, const char *paths[NDAYS])
+{
+    const char *end;
+    size_t day = parse_day(text, &end);
+
+    bool result = (day != SIZE_MAX) && (*end == '=') && end[1];
+    if (result)
+    {
+        paths[day] = end + 1;
+    }
+
+    return result;
+}
+
+
+static void
+usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options] [day[.part] ...]\n"
+            "\n"
+            "Solves the given days, or parts of days, or else all of them.\n"
+            "\n"
+            "  -C dir          read the usual inputs from dir rather than the current directory\n"
+            "  -i day=path     read the day's input from path, or stdin if it's -,\n"
+            "                  without checking the answers\n"
+            "  -r count        solve everything count times, printing the answers once\n"
+            "  --scalar        don't use the SIMD kernels or split a part across threads\n"
+            "  --bench         time each part and print the statistics as JSON\n"
+            "  -n iterations   timed runs of each part (default %d)\n"
+            "  -w warmup       untimed runs of each part beforehand (default %d)\n"
+            "  --counters      run each part once under the hardware performance counters\n",
+            program, DEFAULT_ITERATIONS, DEFAULT_WARMUP);
+}
+
+
+typedef enum Mode
+{
+    MODE_SOLVE,
+    MODE_BENCH,
+    MODE_COUNTERS,
+} Mode;
+
+
 int
-main(void)
+main(int argc, char **argv)
 {
-    Buffer *input = read_file("day01.txt");
-    day01(input->data);
+    static Schedule schedule;
+
+    Mode mode = MODE_SOLVE;
+    size_t iterations = DEFAULT_ITERATIONS;
+    size_t warmup = DEFAULT_WARMUP;
+    size_t repeat = 1;
+    const char *datadir = ".";
+    const char *paths[NDAYS] = { 0 };
+    bool valid = true;
+
+    for (int i = 1; valid && (i < argc); ++i)
+    {
+        const char *arg = argv[i];
+        bool has_value = (i + 1 < argc);
+
+        if (strcmp(arg, "--bench") == 0)
+        {
+            mode = MODE_BENCH;
+        }
+        else if (strcmp(arg, "--counters") == 0)
+        {
+            mode = MODE_COUNTERS;
+        }
+        else if (strcmp(arg, "--scalar") == 0)
+        {
+            force_scalar = true;
+        }
+        else if ((strcmp(arg, "-n") == 0) && has_value)
+        {
+            iterations = parse_count(argv[++i]);
+        }
+        else if ((strcmp(arg, "-w") == 0) && has_value)
+        {
+            warmup = parse_count(argv[++i]);
+        }
+        else if ((strcmp(arg, "-r") == 0) && has_value)
+        {
+            repeat = parse_count(argv[++i]);
+        }
+        else if ((strcmp(arg, "-C") == 0) && has_value)
+        {
+            datadir = argv[++i];
+        }
+        else if ((strcmp(arg, "-i") == 0) && has_value)
+        {
+            valid = parse_override(argv[++i], paths);
+        }
+        else
+        {
+            valid = parse_selection(arg, schedule.selected);
+        }
+    }
 
-    input = read_file("day02.txt");
-    day02(input->data);
+    // stdin can only be read once
+    size_t stdin_days = 0;
+    for (size_t i = 0; i < NDAYS; ++i)
+    {
+        stdin_days += (paths[i] && (strcmp(paths[i], "-") == 0));
+    }
+
+    valid = valid
+         && (iterations != 0) && (iterations != SIZE_MAX)
+         && (warmup != SIZE_MAX)
+         && (repeat != 0) && (repeat != SIZE_MAX)
+         && (stdin_days <= 1);
+
+    if (!valid)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool any_selected = false;
+    for (size_t i = 0; i < NDAYS; ++i)
+    {
+        any_selected |= is_day_selected(&schedule, i);
+    }
+
+    for (size_t i = 0; i < NDAYS; ++i)
+    {
+        if (!any_selected)
+        {
+            schedule.selected[i][0] = true;
+            schedule.selected[i][1] = true;
+        }
 
-    input = read_file("day03.txt");
-    day03(input->data);
+        schedule.check[i] = !paths[i];
+        if (is_day_selected(&schedule, i))
+        {
+            load_input(days[i], paths[i], datadir, schedule.inputs + i);
+        }
+    }
 
-    day04();
+    switch (mode)
+    {
+        case MODE_SOLVE:
+            solve(&schedule, repeat);
+            break;
 
-    input = read_file("day05.txt");
-    day05(input->data);
+        case MODE_BENCH:
+            benchmark(&schedule, iterations, warmup);
+            break;
 
-    input = read_file("day06.txt");
-    day06(input->data);
+        case MODE_COUNTERS:
+            count_events(&schedule);
+            break;
+    }
 
-    input = read_file("day07.txt");
-    day07(input->data);
+    for (size_t i = 0; i < NDAYS; ++i)
+    {
+        if (is_day_selected(&schedule, i))
+        {
+            release_input(schedule.inputs + i);
+        }
+    }
 }
@@ -0,0 +1,249 @@
+#include "md5.h"
+
+#include <assert.h>
+#include <string.h>
+
+
+const uint32_t md5_table[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const unsigned char pad_bytes[2 * MD5_BLOCK_SIZE] = { 0x80 };
+
+
+static uint32_t
+load_word(const unsigned char *bytes)
+{
+    // MD5 words are little-endian.
+    uint32_t result = (uint32_t)bytes[0]
+        | ((uint32_t)bytes[1] << 8)
+        | ((uint32_t)bytes[2] << 16)
+        | ((uint32_t)bytes[3] << 24);
+    return result;
+}
+
+
+void
+md5_compress(uint32_t *state, const unsigned char *block)
+{
+    uint32_t X[16];
+    for (size_t i = 0; i < 16; ++i)
+    {
+        X[i] = load_word(block + 4 * i);
+    }
+
+    uint32_t A = state[0];
+    uint32_t B = state[1];
+    uint32_t C = state[2];
+    uint32_t D = state[3];
+
+#define ROUND(a, b, c, d, k, s, i) \
+    a += F(b, c, d) + X[k] + md5_table[i]; \
+    a = ROTATE_LEFT(a, s); \
+    a += b
+
+#define ROTATE_LEFT(value, amount) (value << amount) | (value >> (32 - amount))
+
+    // round 1
+#define F(x, y, z) ((x & y) | ((~x) & z))
+    ROUND(A, B, C, D,  0,  7,  0);
+    ROUND(D, A, B, C,  1, 12,  1);
+    ROUND(C, D, A, B,  2, 17,  2);
+    ROUND(B, C, D, A,  3, 22,  3);
+
+    ROUND(A, B, C, D,  4,  7,  4);
+    ROUND(D, A, B, C,  5, 12,  5);
+    ROUND(C, D, A, B,  6, 17,  6);
+    ROUND(B, C, D, A,  7, 22,  7);
+
+    ROUND(A, B, C, D,  8,  7,  8);
+    ROUND(D, A, B, C,  9, 12,  9);
+    ROUND(C, D, A, B, 10, 17, 10);
+    ROUND(B, C, D, A, 11, 22, 11);
+
+    ROUND(A, B, C, D, 12,  7, 12);
+    ROUND(D, A, B, C, 13, 12, 13);
+    ROUND(C, D, A, B, 14, 17, 14);
+    ROUND(B, C, D, A, 15, 22, 15);
+#undef F
+
+    // round 2
+#define F(x, y, z) ((x & z) | (y & (~z)))
+    ROUND(A, B, C, D,  1,   5,  16);
+    ROUND(D, A, B, C,  6,   9,  17);
+    ROUND(C, D, A, B, 11,  14,  18);
+    ROUND(B, C, D, A,  0,  20,  19);
+
+    ROUND(A, B, C, D,  5,   5,  20);
+    ROUND(D, A, B, C, 10,   9,  21);
+    ROUND(C, D, A, B, 15,  14,  22);
+    ROUND(B, C, D, A,  4,  20,  23);
+
+    ROUND(A, B, C, D,  9,   5,  24);
+    ROUND(D, A, B, C, 14,   9,  25);
+    ROUND(C, D, A, B,  3,  14,  26);
+    ROUND(B, C, D, A,  8,  20,  27);
+
+    ROUND(A, B, C, D, 13,   5,  28);
+    ROUND(D, A, B, C,  2,   9,  29);
+    ROUND(C, D, A, B,  7,  14,  30);
+    ROUND(B, C, D, A, 12,  20,  31);
+#undef F
+
+    // round 3
+#define F(x, y, z) (x ^ y ^ z)
+    ROUND(A, B, C, D,  5,   4,  32);
+    ROUND(D, A, B, C,  8,  11,  33);
+    ROUND(C, D, A, B, 11,  16,  34);
+    ROUND(B, C, D, A, 14,  23,  35);
+
+    ROUND(A, B, C, D,  1,   4,  36);
+    ROUND(D, A, B, C,  4,  11,  37);
+    ROUND(C, D, A, B,  7,  16,  38);
+    ROUND(B, C, D, A, 10,  23,  39);
+
+    ROUND(A, B, C, D, 13,   4,  40);
+    ROUND(D, A, B, C,  0,  11,  41);
+    ROUND(C, D, A, B,  3,  16,  42);
+    ROUND(B, C, D, A,  6,  23,  43);
+
+    ROUND(A, B, C, D,  9,   4,  44);
+    ROUND(D, A, B, C, 12,  11,  45);
+    ROUND(C, D, A, B, 15,  16,  46);
+    ROUND(B, C, D, A,  2,  23,  47);
+#undef F
+
+    // round 4
+#define F(x, y, z) (y ^ (x | (~z)))
+    ROUND(A, B, C, D,  0,   6,  48);
+    ROUND(D, A, B, C,  7,  10,  49);
+    ROUND(C, D, A, B, 14,  15,  50);
+    ROUND(B, C, D, A,  5,  21,  51);
+
+    ROUND(A, B, C, D, 12,   6,  52);
+    ROUND(D, A, B, C,  3,  10,  53);
+    ROUND(C, D, A, B, 10,  15,  54);
+    ROUND(B, C, D, A,  1,  21,  55);
+
+    ROUND(A, B, C, D,  8,   6,  56);
+    ROUND(D, A, B, C, 15,  10,  57);
+    ROUND(C, D, A, B,  6,  15,  58);
+    ROUND(B, C, D, A, 13,  21,  59);
+
+    ROUND(A, B, C, D,  4,   6,  60);
+    ROUND(D, A, B, C, 11,  10,  61);
+    ROUND(C, D, A, B,  2,  15,  62);
+    ROUND(B, C, D, A,  9,  21,  63);
+#undef F
+
+#undef ROUND
+#undef ROTATE_LEFT
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+}
+
+
+void
+md5_init(Md5 *md5)
+{
+    // initialization vectors
+    md5->state[0] = 0x67452301;
+    md5->state[1] = 0xefcdab89;
+    md5->state[2] = 0x98badcfe;
+    md5->state[3] = 0x10325476;
+    md5->length = 0;
+}
+
+
+void
+md5_update(Md5 *md5, const void *data, size_t length)
+{
+    const unsigned char *input = data;
+    size_t used = md5->length & (MD5_BLOCK_SIZE - 1);
+    md5->length += length;
+
+    // Top up a partially filled buffer first.
+    if (used)
+    {
+        size_t count = MD5_BLOCK_SIZE - used;
+        if (count > length)
+        {
+            count = length;
+        }
+
+        memcpy(md5->buffer + used, input, count);
+        input += count;
+        length -= count;
+        used += count;
+
+        if (used < MD5_BLOCK_SIZE)
+        {
+            return;
+        }
+
+        md5_compress(md5->state, md5->buffer);
+    }
+
+    // Whole blocks are hashed straight out of the input.
+    while (length >= MD5_BLOCK_SIZE)
+    {
+        md5_compress(md5->state, input);
+        input += MD5_BLOCK_SIZE;
+        length -= MD5_BLOCK_SIZE;
+    }
+
+    memcpy(md5->buffer, input, length);
+}
+
+
+void
+md5_final(Md5 *md5, unsigned char *digest)
+{
+    // Pad the message with a '1' bit, some number of zero bits, and the
+    // message length in bits, truncated to 64 bits, so the message is an exact
+    // multiple of 64 bytes (512 bits). The '1' bit and length are always
+    // required, so they may spill into an extra block.
+    uint64_t bit_length = 8 * md5->length;
+
+    size_t used = md5->length & (MD5_BLOCK_SIZE - 1);
+    size_t pad_length = MD5_BLOCK_SIZE - sizeof(bit_length) - used;
+    if (used >= (MD5_BLOCK_SIZE - sizeof(bit_length)))
+    {
+        pad_length += MD5_BLOCK_SIZE;
+    }
+    md5_update(md5, pad_bytes, pad_length);
+
+    unsigned char length_bytes[sizeof(bit_length)];
+    for (size_t i = 0; i < sizeof(length_bytes); ++i)
+    {
+        length_bytes[i] = (unsigned char)(bit_length >> (8 * i));
+    }
+    md5_update(md5, length_bytes, sizeof(length_bytes));
+    assert((md5->length & (MD5_BLOCK_SIZE - 1)) == 0);
+
+    for (size_t i = 0; i < MD5_DIGEST_SIZE; ++i)
+    {
+        digest[i] = (unsigned char)(md5->state[i / 4] >> (8 * (i & 3)));
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef AOC_MD5_H
+#define AOC_MD5_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define MD5_BLOCK_SIZE 64
+#define MD5_DIGEST_SIZE 16
+
+
+typedef struct Md5
+{
+    uint32_t state[4];
+    // total number of bytes absorbed so far
+    uint64_t length;
+    // bytes absorbed but not yet hashed, i.e., (length % MD5_BLOCK_SIZE) bytes
+    unsigned char buffer[MD5_BLOCK_SIZE];
+} Md5;
+
+
+// The per-step additive constants, for code that runs its own compression.
+extern const uint32_t md5_table[64];
+
+
+void
+md5_init(Md5 *md5);
+
+
+void
+md5_update(Md5 *md5, const void *data, size_t length);
+
+
+void
+md5_final(Md5 *md5, unsigned char *digest);
+
+
+// Hashes one 64-byte block into state. The block is read in place and need not
+// be aligned.
+void
+md5_compress(uint32_t *state, const unsigned char *block);
+
+
+#endif // AOC_MD5_H
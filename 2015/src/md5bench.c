@@ -0,0 +1,233 @@
+// Measures the throughput of the streaming MD5 hasher.
+//
+// usage: md5bench [-s gigabytes] [file ...]
+//
+// With no files, hashes the given number of gigabytes (default 4) of
+// synthetic data held in memory. Otherwise hashes each file, md5sum-style.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "md5.h"
+
+// posix
+#include <time.h>
+
+// stdlib
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define ARRAY_SIZE(array) (sizeof(array)/sizeof(*(array)))
+
+#define SYNTHETIC_BUFFER_SIZE (64 << 20)
+#define FILE_BUFFER_SIZE (1 << 20)
+
+
+static double
+now(void)
+{
+    struct timespec time;
+    int status = clock_gettime(CLOCK_MONOTONIC, &time);
+    assert(status == 0);
+
+    double result = (double)time.tv_sec + ((double)time.tv_nsec / 1e9);
+    return result;
+}
+
+
+static void
+format_digest(const unsigned char *digest, char *output)
+{
+    const char bin2hex[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+    for (size_t i = 0, o = 0; i < MD5_DIGEST_SIZE; ++i, o += 2)
+    {
+        unsigned char c = digest[i];
+        output[o] = bin2hex[(c >> 4) & 0xf];
+        output[o + 1] = bin2hex[c & 0xf];
+    }
+    output[2 * MD5_DIGEST_SIZE] = 0;
+}
+
+
+static void
+test_md5(void)
+{
+    typedef struct Test
+    {
+        const char *input;
+        const char *expected;
+    } Test;
+
+    // test suite from RFC 1321
+    const Test tests[] = {
+        { "", "d41d8cd98f00b204e9800998ecf8427e" },
+        { "a", "0cc175b9c0f1b6a831c399e269772661" },
+        { "abc", "900150983cd24fb0d6963f7d28e17f72" },
+        { "message digest", "f96b697d7cb7938d525a2f31aaf161d0" },
+        { "abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b" },
+        { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "d174ab98d277d9f5a5611c2c9f419d9f" },
+        { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", "57edf4a22be3c955ac49da2e2107b67a" },
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(tests); ++i)
+    {
+        const Test *test = tests + i;
+        size_t length = strlen(test->input);
+        unsigned char digest[MD5_DIGEST_SIZE];
+        char actual[2 * MD5_DIGEST_SIZE + 1];
+
+        // all at once
+        Md5 md5;
+        md5_init(&md5);
+        md5_update(&md5, test->input, length);
+        md5_final(&md5, digest);
+        format_digest(digest, actual);
+        assert(strcmp(actual, test->expected) == 0);
+
+        // a byte at a time, to exercise the partial block buffer
+        md5_init(&md5);
+        for (size_t j = 0; j < length; ++j)
+        {
+            md5_update(&md5, test->input + j, 1);
+        }
+        md5_final(&md5, digest);
+        format_digest(digest, actual);
+        assert(strcmp(actual, test->expected) == 0);
+    }
+}
+
+
+static void
+report(const char *name, uint64_t length, double seconds, const unsigned char *digest)
+{
+    char hex[2 * MD5_DIGEST_SIZE + 1];
+    format_digest(digest, hex);
+    printf("%s  %s  %.3f GB in %.3f s: %.3f GB/s\n",
+           hex, name, (double)length / 1e9, seconds, (double)length / 1e9 / seconds);
+}
+
+
+static void
+bench_synthetic(double gigabytes)
+{
+    unsigned char *buffer = malloc(SYNTHETIC_BUFFER_SIZE);
+    assert(buffer);
+
+    // Fill with something less regular than zeroes (xorshift32).
+    uint32_t x = 2463534242;
+    for (size_t i = 0; i < SYNTHETIC_BUFFER_SIZE; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buffer[i] = (unsigned char)x;
+    }
+
+    uint64_t total = (uint64_t)(gigabytes * 1e9);
+
+    double start = now();
+    Md5 md5;
+    md5_init(&md5);
+    for (uint64_t remaining = total; remaining;)
+    {
+        size_t length = SYNTHETIC_BUFFER_SIZE;
+        if (remaining < length)
+        {
+            length = (size_t)remaining;
+        }
+
+        md5_update(&md5, buffer, length);
+        remaining -= length;
+    }
+
+    unsigned char digest[MD5_DIGEST_SIZE];
+    md5_final(&md5, digest);
+    double seconds = now() - start;
+
+    report("(synthetic)", total, seconds, digest);
+    free(buffer);
+}
+
+
+static bool
+bench_file(const char *filename, unsigned char *buffer)
+{
+    FILE *fh = fopen(filename, "rb");
+    if (!fh)
+    {
+        perror(filename);
+        return false;
+    }
+
+    double start = now();
+    Md5 md5;
+    md5_init(&md5);
+    uint64_t length = 0;
+
+    size_t bytes_read;
+    while ((bytes_read = fread(buffer, 1, FILE_BUFFER_SIZE, fh)) > 0)
+    {
+        md5_update(&md5, buffer, bytes_read);
+        length += bytes_read;
+    }
+
+    bool result = !ferror(fh);
+    fclose(fh);
+
+    unsigned char digest[MD5_DIGEST_SIZE];
+    md5_final(&md5, digest);
+    double seconds = now() - start;
+
+    if (result)
+    {
+        report(filename, length, seconds, digest);
+    }
+    else
+    {
+        perror(filename);
+    }
+
+    return result;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    test_md5();
+
+    double gigabytes = 4;
+    int first_file = 1;
+    if ((argc > 2) && (strcmp(argv[1], "-s") == 0))
+    {
+        gigabytes = strtod(argv[2], 0);
+        assert(gigabytes > 0);
+        first_file = 3;
+    }
+
+    int result = EXIT_SUCCESS;
+    if (first_file < argc)
+    {
+        unsigned char *buffer = malloc(FILE_BUFFER_SIZE);
+        assert(buffer);
+
+        for (int i = first_file; i < argc; ++i)
+        {
+            if (!bench_file(argv[i], buffer))
+            {
+                result = EXIT_FAILURE;
+            }
+        }
+
+        free(buffer);
+    }
+    else
+    {
+        bench_synthetic(gigabytes);
+    }
+
+    return result;
+}
@@ -0,0 +1,161 @@
+#include "2015.h"
+#include "parallel.h"
+
+// posix
+#include <pthread.h>
+#include <unistd.h>
+
+// stdlib
+#include <assert.h>
+#include <string.h>
+
+
+typedef struct Worker
+{
+    ParallelTask *task;
+    void *data;
+    uint32_t index;
+    pthread_t thread;
+} Worker;
+
+
+typedef struct LineChunks
+{
+    LineTask *task;
+    void *data;
+    const char *input;
+    // chunk i is [offsets[i], offsets[i + 1])
+    size_t offsets[MAX_WORKERS + 1];
+} LineChunks;
+
+
+static void *
+run_worker(void *arg)
+{
+    Worker *worker = arg;
+    worker->task(worker->data, worker->index);
+    return 0;
+}
+
+
+uint32_t
+processor_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    uint32_t result = 1;
+    if (count > MAX_WORKERS)
+    {
+        result = MAX_WORKERS;
+    }
+    else if (count > 1)
+    {
+        result = (uint32_t)count;
+    }
+
+    return result;
+}
+
+
+uint32_t
+worker_count(void)
+{
+    uint32_t result = force_scalar ? 1 : processor_count();
+    return result;
+}
+
+
+uint32_t
+input_chunk_count(size_t length)
+{
+    uint32_t result = 1;
+    if (length >= MIN_PARALLEL_LENGTH)
+    {
+        result = worker_count();
+    }
+
+    return result;
+}
+
+
+size_t
+chunk_length(size_t length, size_t chunk_size, uint32_t chunk)
+{
+    size_t offset = chunk * chunk_size;
+    size_t result = 0;
+    if (offset < length)
+    {
+        result = length - offset;
+        if (result > chunk_size)
+        {
+            result = chunk_size;
+        }
+    }
+
+    return result;
+}
+
+
+void
+run_parallel(ParallelTask *task, void *data, uint32_t nworkers)
+{
+    assert((nworkers > 0) && (nworkers <= MAX_WORKERS));
+
+    Worker workers[MAX_WORKERS];
+    for (uint32_t i = 1; i < nworkers; ++i)
+    {
+        Worker *worker = workers + i;
+        worker->task = task;
+        worker->data = data;
+        worker->index = i;
+        int status = pthread_create(&worker->thread, 0, run_worker, worker);
+        assert(status == 0);
+    }
+
+    task(data, 0);
+
+    for (uint32_t i = 1; i < nworkers; ++i)
+    {
+        int status = pthread_join(workers[i].thread, 0);
+        assert(status == 0);
+    }
+}
+
+
+static void
+run_line_chunk(void *data, uint32_t worker)
+{
+    LineChunks *chunks = data;
+    size_t offset = chunks->offsets[worker];
+    chunks->task(chunks->input + offset, chunks->offsets[worker + 1] - offset, chunks->data, worker);
+}
+
+
+void
+run_parallel_lines(LineTask *task, void *data, const char *input, size_t length, uint32_t nchunks)
+{
+    assert((nchunks > 0) && (nchunks <= MAX_WORKERS));
+
+    LineChunks chunks;
+    chunks.task = task;
+    chunks.data = data;
+    chunks.input = input;
+
+    chunks.offsets[0] = 0;
+    for (uint32_t i = 1; i < nchunks; ++i)
+    {
+        // Move each split forward to the start of the next line, unless an
+        // earlier long line already took it past here.
+        size_t offset = (size_t)(((uint64_t)length * i) / nchunks);
+        if (offset < chunks.offsets[i - 1])
+        {
+            offset = chunks.offsets[i - 1];
+        }
+
+        const char *newline = memchr(input + offset, '\n', length - offset);
+        chunks.offsets[i] = newline ? (size_t)(newline - input) + 1 : length;
+    }
+    chunks.offsets[nchunks] = length;
+
+    run_parallel(run_line_chunk, &chunks, nchunks);
+}
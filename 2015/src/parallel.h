@@ -0,0 +1,58 @@
+#ifndef AOC_PARALLEL_H
+#define AOC_PARALLEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// processor_count() never returns more than this.
+#define MAX_WORKERS 256
+
+// Inputs shorter than this aren't worth splitting across threads.
+#define MIN_PARALLEL_LENGTH (4 << 20)
+
+
+typedef void ParallelTask(void *data, uint32_t worker);
+
+// Handles one chunk of whole lines of an input. The chunk isn't terminated, so
+// the byte at input[length] may be the start of the next chunk.
+typedef void LineTask(const char *input, size_t length, void *data, uint32_t chunk);
+
+
+uint32_t
+processor_count(void);
+
+
+// How many workers a solver spreads its work over: processor_count(), or just
+// one under force_scalar, so reference answers don't depend on the threaded
+// reductions either.
+uint32_t
+worker_count(void);
+
+
+// How many chunks to split an input of `length` bytes into for a reduction:
+// worker_count(), or just one if the input is short.
+uint32_t
+input_chunk_count(size_t length);
+
+
+// Returns the length of the given chunk when `length` bytes are cut into
+// chunks of chunk_size. The last chunk may be short, and any after it empty.
+size_t
+chunk_length(size_t length, size_t chunk_size, uint32_t chunk);
+
+
+// Runs task(data, worker) for every worker in [0, nworkers) on its own thread
+// and waits for all of them to finish. Worker 0 runs on the calling thread.
+void
+run_parallel(ParallelTask *task, void *data, uint32_t nworkers);
+
+
+// Splits input into nchunks roughly equal chunks, each ending just after a
+// newline (or at the end of the input), and runs task on each on its own
+// thread, like run_parallel(). Chunks may be empty if lines are long.
+void
+run_parallel_lines(LineTask *task, void *data, const char *input, size_t length, uint32_t nchunks);
+
+
+#endif // AOC_PARALLEL_H
@@ -0,0 +1,145 @@
+// syscall
+#define _DEFAULT_SOURCE
+
+#include "perf.h"
+
+// linux
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// stdlib
+#include <string.h>
+
+
+#define CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+
+const char *const perf_event_names[PERF_EVENT_COUNT] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_BRANCH_MISSES] = "branch-misses",
+    [PERF_L1D_MISSES] = "L1d-misses",
+    [PERF_LLC_MISSES] = "LLC-misses",
+};
+
+
+typedef struct EventConfig
+{
+    uint32_t type;
+    uint64_t config;
+} EventConfig;
+
+
+static const EventConfig event_configs[PERF_EVENT_COUNT] = {
+    [PERF_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [PERF_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [PERF_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [PERF_L1D_MISSES] = { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    [PERF_LLC_MISSES] = { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+};
+
+
+// The layout read() returns for PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING.
+typedef struct EventReading
+{
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+} EventReading;
+
+
+static int
+open_event(const EventConfig *event)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event->type;
+    attr.config = event->config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = 1;
+    // Count the worker threads the solvers start, too. Their counts are folded
+    // into ours as they exit, which run_parallel() waits for.
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // this thread, any cpu, no group, no flags
+    int result = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return result;
+}
+
+
+bool
+perf_open(PerfCounters *counters)
+{
+    bool result = false;
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        counters->fds[i] = open_event(event_configs + i);
+        result |= (counters->fds[i] >= 0);
+    }
+
+    return result;
+}
+
+
+void
+perf_close(PerfCounters *counters)
+{
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (counters->fds[i] >= 0)
+        {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+}
+
+
+void
+perf_start(PerfCounters *counters)
+{
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (counters->fds[i] >= 0)
+        {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+
+void
+perf_stop(PerfCounters *counters, PerfSample *sample)
+{
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (counters->fds[i] >= 0)
+        {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        EventReading reading = { 0 };
+        bool available = (counters->fds[i] >= 0)
+                      && (read(counters->fds[i], &reading, sizeof(reading)) == sizeof(reading))
+                      && (reading.time_running > 0);
+
+        uint64_t value = reading.value;
+        if (available && (reading.time_running < reading.time_enabled))
+        {
+            value = (uint64_t)((double)value * (double)reading.time_enabled / (double)reading.time_running);
+        }
+
+        sample->available[i] = available;
+        sample->values[i] = available ? value : 0;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef AOC_PERF_H
+#define AOC_PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef enum PerfEvent
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+
+    PERF_EVENT_COUNT
+} PerfEvent;
+
+
+// Hardware counters for the calling thread and any threads it starts while
+// they're open. Events the kernel or machine doesn't support are left closed
+// and read back as unavailable.
+typedef struct PerfCounters
+{
+    int fds[PERF_EVENT_COUNT];
+} PerfCounters;
+
+
+typedef struct PerfSample
+{
+    bool available[PERF_EVENT_COUNT];
+    // scaled up when the kernel had to multiplex the counters
+    uint64_t values[PERF_EVENT_COUNT];
+} PerfSample;
+
+
+extern const char *const perf_event_names[PERF_EVENT_COUNT];
+
+
+// Returns false if no counters at all could be opened.
+bool
+perf_open(PerfCounters *counters);
+
+
+void
+perf_close(PerfCounters *counters);
+
+
+// Zeroes and starts the counters. Counts already folded in from threads that
+// have exited aren't zeroed, so measure anything after threads have run with a
+// freshly opened set.
+void
+perf_start(PerfCounters *counters);
+
+
+// Stops the counters and reads them.
+void
+perf_stop(PerfCounters *counters, PerfSample *sample);
+
+
+#endif // AOC_PERF_H